@@ -7,6 +7,7 @@
 #include "include/buffer.h"
 #include "include/byteorder.h"
 #include "include/ceph_assert.h"
+#include "include/crc32c.h"
 
 #include "xxHash/xxhash.h"
 
@@ -90,6 +91,14 @@ public:
       ) {
       return p.crc32c(len, init_value);
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return ceph_crc32c(init_value, (const unsigned char*)data, len);
+    }
   };
 
   struct crc32c_16 {
@@ -111,6 +120,14 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xffff;
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return ceph_crc32c(init_value, (const unsigned char*)data, len) & 0xffff;
+    }
   };
 
   struct crc32c_8 {
@@ -132,6 +149,14 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xff;
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return ceph_crc32c(init_value, (const unsigned char*)data, len) & 0xff;
+    }
   };
 
   struct xxhash32 {
@@ -161,6 +186,14 @@ public:
       }
       return XXH32_digest(state);
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return XXH32(data, len, init_value);
+    }
   };
 
   struct xxhash64 {
@@ -190,8 +223,49 @@ public:
       }
       return XXH64_digest(state);
     }
+    static init_value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return XXH64(data, len, init_value);
+    }
   };
 
+  /// Checksum @p blocks consecutive blocks starting at @p p and pass each
+  /// value to @p f, stopping early if it returns false.  Blocks that lie
+  /// within a single buffer are hashed straight from memory; only blocks
+  /// straddling buffer boundaries go through the iterator.
+  template<class Alg, class F>
+  static void for_each_block(
+    typename Alg::state_t state,
+    typename Alg::init_value_t init_value,
+    size_t csum_block_size,
+    size_t blocks,
+    ceph::buffer::list::const_iterator& p,
+    F&& f) {
+    while (blocks > 0) {
+      ceph::buffer::ptr cur = p.get_current_ptr();
+      size_t n = std::min(blocks, cur.length() / csum_block_size);
+      if (n == 0) {
+	if (!f(Alg::calc(state, init_value, csum_block_size, p))) {
+	  return;
+	}
+	--blocks;
+	continue;
+      }
+      const char *data = cur.c_str();
+      for (size_t i = 0; i < n; ++i, data += csum_block_size) {
+	if (!f(Alg::calc(state, init_value, csum_block_size, data))) {
+	  return;
+	}
+      }
+      p += n * csum_block_size;
+      blocks -= n;
+    }
+  }
+
   template<class Alg>
   static int calculate(
     size_t csum_block_size,
@@ -225,10 +299,11 @@ public:
     typename Alg::value_t *pv =
       reinterpret_cast<typename Alg::value_t*>(csum_data->c_str());
     pv += offset / csum_block_size;
-    while (blocks--) {
-      *pv = Alg::calc(state, init_value, csum_block_size, p);
-      ++pv;
-    }
+    for_each_block<Alg>(state, init_value, csum_block_size, blocks, p,
+      [&pv](typename Alg::init_value_t v) {
+	*pv++ = v;
+	return true;
+      });
     Alg::fini(&state);
     return 0;
   }
@@ -253,21 +328,22 @@ public:
       reinterpret_cast<const typename Alg::value_t*>(csum_data.c_str());
     pv += offset / csum_block_size;
     size_t pos = offset;
-    while (length > 0) {
-      typename Alg::init_value_t v = Alg::calc(state, -1, csum_block_size, p);
-      if (*pv != v) {
-	if (bad_csum) {
-	  *bad_csum = v;
+    int bad_pos = -1;
+    for_each_block<Alg>(state, -1, csum_block_size, length / csum_block_size,
+      p, [&](typename Alg::init_value_t v) {
+	if (*pv != v) {
+	  if (bad_csum) {
+	    *bad_csum = v;
+	  }
+	  bad_pos = pos;
+	  return false;
 	}
-	Alg::fini(&state);
-	return pos;
-      }
-      ++pv;
-      pos += csum_block_size;
-      length -= csum_block_size;
-    }
+	++pv;
+	pos += csum_block_size;
+	return true;
+      });
     Alg::fini(&state);
-    return -1;  // no errors
+    return bad_pos;  // -1 if no errors
   }
 };
 
@@ -106,6 +106,8 @@ OPTION(ms_cluster_type, OPT_STR)   // messenger backend
 OPTION(ms_learn_addr_from_peer, OPT_BOOL)
 OPTION(ms_tcp_nodelay, OPT_BOOL)
 OPTION(ms_tcp_rcvbuf, OPT_INT)
+OPTION(ms_tcp_zerocopy, OPT_BOOL)
+OPTION(ms_tcp_zerocopy_min_size, OPT_U64)
 OPTION(ms_tcp_prefetch_max_size, OPT_U32) // max prefetch size, we limit this to avoid extra memcpy
 OPTION(ms_initial_backoff, OPT_DOUBLE)
 OPTION(ms_max_backoff, OPT_DOUBLE)
@@ -143,6 +145,8 @@ OPTION(ms_dump_on_send, OPT_BOOL)           // hexdump msg to log on send
 OPTION(ms_dump_corrupt_message_level, OPT_INT)  // debug level to hexdump undecodeable messages at
 OPTION(ms_async_op_threads, OPT_U64)            // number of worker processing threads for async messenger created on init
 OPTION(ms_async_max_op_threads, OPT_U64)        // max number of worker processing threads for async messenger
+OPTION(ms_async_batch_window_us, OPT_U32)
+OPTION(ms_async_batch_max_bytes, OPT_U64)
 OPTION(ms_async_rdma_device_name, OPT_STR)
 OPTION(ms_async_rdma_enable_hugepage, OPT_BOOL)
 OPTION(ms_async_rdma_buffer_size, OPT_INT)
@@ -612,6 +616,7 @@ OPTION(osd_op_num_threads_per_shard_ssd, OPT_INT)
 OPTION(osd_op_num_shards, OPT_INT)
 OPTION(osd_op_num_shards_hdd, OPT_INT)
 OPTION(osd_op_num_shards_ssd, OPT_INT)
+OPTION(osd_op_queue_work_stealing, OPT_BOOL)
 
 // PrioritzedQueue (prio), Weighted Priority Queue (wpq ; default),
 // mclock_opclass, mclock_client, or debug_random. "mclock_opclass"
@@ -630,6 +635,8 @@ OPTION(osd_ignore_stale_divergent_priors, OPT_BOOL) // do not assert on divergen
 // If set to true even after reading enough shards to
 // decode the object, any error will be reported.
 OPTION(osd_read_ec_check_for_errors, OPT_BOOL) // return error if any ec shard has an error
+OPTION(osd_ec_partial_reads, OPT_BOOL)
+OPTION(osd_ec_parity_delta_writes, OPT_BOOL)
 
 OPTION(osd_debug_feed_pullee, OPT_INT)
 
@@ -678,6 +685,8 @@ OPTION(osd_recovery_max_active_hdd, OPT_U64)
 OPTION(osd_recovery_max_active_ssd, OPT_U64)
 OPTION(osd_recovery_max_single_start, OPT_U64)
 OPTION(osd_recovery_max_chunk, OPT_U64)  // max size of push chunk
+OPTION(osd_recovery_batch_small_objects, OPT_U64)
+OPTION(osd_recovery_small_object_size, OPT_U64)
 OPTION(osd_recovery_max_omap_entries_per_chunk, OPT_U64) // max number of omap entries per chunk; 0 to disable limit
 OPTION(osd_copyfrom_max_chunk, OPT_U64)   // max size of a COPYFROM chunk
 OPTION(osd_push_per_object_cost, OPT_U64)  // push cost per object
@@ -704,6 +713,8 @@ OPTION(osd_scrub_auto_repair_num_errors, OPT_U32)   // only auto-repair when num
 OPTION(osd_deep_scrub_interval, OPT_FLOAT) // once a week
 OPTION(osd_deep_scrub_randomize_ratio, OPT_FLOAT) // scrubs will randomly become deep scrubs at this rate (0.15 -> 15% of scrubs are deep)
 OPTION(osd_deep_scrub_stride, OPT_INT)
+OPTION(osd_deep_scrub_bytes_per_sec, OPT_U64)
+OPTION(osd_deep_scrub_verify_store_csum, OPT_BOOL)
 OPTION(osd_deep_scrub_keys, OPT_INT)
 OPTION(osd_deep_scrub_update_digest_min_age, OPT_INT)   // objects must be this old (seconds) before we update the whole-object digest on scrub
 OPTION(osd_skip_data_digest, OPT_BOOL)
@@ -903,6 +914,8 @@ OPTION(objectstore_blackhole, OPT_BOOL)
 OPTION(bluefs_alloc_size, OPT_U64)
 OPTION(bluefs_shared_alloc_size, OPT_U64)
 OPTION(bluefs_max_prefetch, OPT_U64)
+OPTION(bluefs_readahead_min, OPT_U64)  // 0 disables random readahead
+OPTION(bluefs_readahead_max_total, OPT_U64)
 OPTION(bluefs_min_log_runway, OPT_U64)  // alloc when we get this low
 OPTION(bluefs_max_log_runway, OPT_U64)  // alloc this much at a time
 OPTION(bluefs_log_compact_min_ratio, OPT_FLOAT)      // before we consider
@@ -1028,6 +1041,9 @@ OPTION(bluestore_throttle_cost_per_io, OPT_U64)
 OPTION(bluestore_deferred_batch_ops, OPT_U64)
 OPTION(bluestore_deferred_batch_ops_hdd, OPT_U64)
 OPTION(bluestore_deferred_batch_ops_ssd, OPT_U64)
+OPTION(bluestore_defrag_bytes_per_sec, OPT_U64)
+OPTION(bluestore_defrag_min_extents, OPT_U64)
+OPTION(bluestore_defrag_max_object_size, OPT_U64)
 OPTION(bluestore_nid_prealloc, OPT_INT)
 OPTION(bluestore_blobid_prealloc, OPT_U64)
 OPTION(bluestore_clone_cow, OPT_BOOL)  // do copy-on-write for clones
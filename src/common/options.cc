@@ -939,6 +939,43 @@ std::vector<Option> get_global_options() {
     .add_see_also("ms_cluster_mode")
     .add_see_also("ms_service_mode"),
 
+    Option("ms_osd_compress_mode", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("none")
+    .set_enum_allowed({"none", "force"})
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Compression policy for msgr2 connections between OSDs")
+    .set_long_description("When set to force on both ends, message payloads of OSD-OSD connections (replication, recovery) are compressed on the wire.  Takes effect for newly established sessions.")
+    .add_see_also("ms_compression_algorithm")
+    .add_see_also("ms_compress_min_size"),
+
+    Option("ms_client_compress_mode", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("none")
+    .set_enum_allowed({"none", "force"})
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Compression policy for msgr2 connections to or from clients")
+    .set_long_description("When set to force on both ends, message payloads of client connections (including rbd-mirror and rgw) are compressed on the wire.  Takes effect for newly established sessions.")
+    .add_see_also("ms_compression_algorithm")
+    .add_see_also("ms_compress_min_size"),
+
+    Option("ms_compression_algorithm", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("snappy")
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Compression algorithms for msgr2 connections in order of preference")
+    .set_long_description("Any compressor plugin (snappy, zstd, zlib, lz4) may be listed.  The accepting side picks the first of its own methods that the connecting side also offers."),
+
+    Option("ms_compress_min_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_K)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Messages smaller than this are not compressed on the wire")
+    .add_see_also("ms_osd_compress_mode")
+    .add_see_also("ms_client_compress_mode"),
+
+    Option("ms_compress_secure", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Allow on-wire compression for connections in secure mode")
+    .set_long_description("Compressing before encrypting can leak information about the plaintext through the ciphertext length."),
+
     Option("ms_learn_addr_from_peer", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description("Learn address from what IP our first peer thinks we connect from")
@@ -952,6 +989,18 @@ std::vector<Option> get_global_options() {
     .set_default(0)
     .set_description("Size of TCP socket receive buffer"),
 
+    Option("ms_tcp_zerocopy", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Send large writes with MSG_ZEROCOPY on posix sockets")
+    .set_long_description("The kernel transmits straight from the message buffers instead of copying them into the socket; the buffers are held until the kernel reports completion.  A socket stops using it as soon as the kernel reports it had to copy anyway (e.g. loopback).  Applies to newly created sockets.")
+    .add_see_also("ms_tcp_zerocopy_min_size"),
+
+    Option("ms_tcp_zerocopy_min_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_description("Minimum size of a send to use MSG_ZEROCOPY")
+    .set_long_description("Page pinning and completion handling cost more than copying for small sends.")
+    .add_see_also("ms_tcp_zerocopy"),
+
     Option("ms_tcp_prefetch_max_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(4_K)
     .set_description("Maximum amount of data to prefetch out of the socket receive buffer"),
@@ -1135,6 +1184,20 @@ std::vector<Option> get_global_options() {
     .set_description("Maximum threadpool size of AsyncMessenger")
     .add_see_also("ms_async_op_threads"),
 
+    Option("ms_async_batch_window_us", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Hold back small writes on a busy connection for up to this many microseconds")
+    .set_long_description("A connection that wrote to its socket less than this long ago queues further small messages and writes them out together when the window ends, instead of issuing a write per event loop wakeup.  An idle connection writes immediately, so only traffic that is already dense sees the added latency.  0, or a window shorter than the resolution of the event loop timers (typically 1-4 ms), disables it.")
+    .add_see_also("ms_async_batch_max_bytes"),
+
+    Option("ms_async_batch_max_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Maximum bytes of outgoing frames to coalesce into one socket write")
+    .set_long_description("Messages queued on a connection are encoded back to back and written with a single socket write until this many bytes are pending.")
+    .add_see_also("ms_async_batch_window_us"),
+
     Option("ms_async_rdma_device_name", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("")
     .set_description(""),
@@ -2362,6 +2425,21 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("objecter_replica_read_latency_factor", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(2.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Skip replicas this many times slower than the fastest one for balanced and localized reads")
+    .set_long_description("The objecter keeps a moving average of the read latency of each OSD.  A balanced or localized read is not sent to an OSD whose average is above this multiple of the lowest average among the acting OSDs of the PG, and among OSDs at the same CRUSH distance the fastest is preferred.  Values below 1 disable latency based selection.")
+    .add_see_also("crush_location")
+    .add_see_also("objecter_replica_read_latency_half_life"),
+
+    Option("objecter_replica_read_latency_half_life", Option::TYPE_SECS, Option::LEVEL_ADVANCED)
+    .set_default(30)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("How quickly the read latency of an unused OSD is forgotten")
+    .set_long_description("An OSD skipped for being slow serves no reads, so its average is not refreshed.  The gap between its average and that of the fastest acting OSD is halved every this many seconds without a new sample, so that it is eventually tried again.  0 keeps the average until a new sample arrives.")
+    .add_see_also("objecter_replica_read_latency_factor"),
+
     Option("filer_max_purge_ops", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_description("Max in-flight operations for purging a striped range (e.g., MDS journal)"),
@@ -2840,6 +2918,13 @@ std::vector<Option> get_global_options() {
     .set_flag(Option::FLAG_STARTUP)
     .set_description(""),
 
+    Option("osd_op_queue_work_stealing", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Let idle op shard threads process items queued on busy shards")
+    .set_long_description("PGs are hashed to a fixed op shard.  With this option, a thread whose shard is empty takes the next item of another shard whose backlog spans more than one PG, so a few hot PGs do not leave the other shards idle.  An item whose PG is being processed is put back in its queue, unless more items of that PG are queued behind it.  Per-PG ordering is preserved.")
+    .add_see_also("osd_op_num_shards"),
+
     Option("osd_op_num_shards_hdd", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(5)
     .set_flag(Option::FLAG_STARTUP)
@@ -2941,6 +3026,18 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("osd_ec_partial_reads", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Read only the requested range from the data shards of an erasure coded object")
+    .set_long_description("When all data shards covering a read are available, each of them is asked for just the part of its chunk that the read covers and no decode is done.  Otherwise whole stripes are read from k shards and decoded."),
+
+    Option("osd_ec_parity_delta_writes", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Update the coding shards of an erasure coded object from the difference between the old and new data on small overwrites")
+    .set_long_description("A partial stripe overwrite normally reads the rest of each stripe from k shards and re-encodes it.  With this option, when the plugin supports it and the write touches fewer than k data shards, only the old content of the touched data shards and of the coding shards is read, and the coding shards are updated with the difference."),
+
     // Only use clone_overlap for recovery if there are fewer than
     // osd_recover_clone_overlap_limit entries in the overlap set
     Option("osd_recover_clone_overlap_limit", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
@@ -3134,6 +3231,22 @@ std::vector<Option> get_global_options() {
     .set_default(8_M)
     .set_description(""),
 
+    Option("osd_recovery_batch_small_objects", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_min(1)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Number of small objects that may share a single recovery operation")
+    .set_long_description("Objects no larger than osd_recovery_small_object_size are recovered in groups of up to this many per reserved recovery operation, so that their data and xattrs are pushed to peers in a single message rather than one message per object.  Objects with omap are never batched, and batched objects still count against osd_recovery_max_active.  A value of 1 disables batching.")
+    .add_see_also("osd_recovery_small_object_size")
+    .add_see_also("osd_recovery_max_active")
+    .add_see_also("osd_max_push_objects"),
+
+    Option("osd_recovery_small_object_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Objects up to this size are eligible for batched recovery")
+    .add_see_also("osd_recovery_batch_small_objects"),
+
     Option("osd_recovery_max_omap_entries_per_chunk", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(8096)
     .set_description(""),
@@ -3261,6 +3374,21 @@ std::vector<Option> get_global_options() {
     .set_default(512_K)
     .set_description("Number of bytes to read from an object at a time during deep scrub"),
 
+    Option("osd_deep_scrub_bytes_per_sec", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Maximum rate at which deep scrub reads object data and omap on this OSD")
+    .set_long_description("Shared by all PGs scrubbing on the OSD, primary and replica alike. When set, scrub waits only as long as it has to stay under this rate, and osd_scrub_sleep and osd_scrub_extended_sleep are ignored. 0 disables the limit.")
+    .add_see_also("osd_scrub_sleep")
+    .add_see_also("osd_deep_scrub_stride"),
+
+    Option("osd_deep_scrub_verify_store_csum", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Have deep scrub of replicated pools verify object data against the object store's own checksums instead of reading it")
+    .set_long_description("The object store checks the data against its stored checksums without passing it up to the OSD, so no data digest is computed: bit rot is still found, but replicas are only compared by size, attrs and omap, and object info data digests are neither checked nor filled in. Objects the store has no checksums for are read as usual.")
+    .add_see_also("bluestore_csum_type"),
+
     Option("osd_deep_scrub_keys", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1024)
     .set_description("Number of keys to read from an object at a time during deep scrub"),
@@ -3985,6 +4113,19 @@ std::vector<Option> get_global_options() {
     .set_default(1_M)
     .set_description(""),
 
+    Option("bluefs_readahead_min", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_description("Initial readahead for random-access files read sequentially, 0 disables")
+    .set_long_description("When consecutive random reads of a file (e.g. a RocksDB iterator walking an SST) continue each other, BlueFS starts reading ahead this much into the reader's buffer and doubles the window on every further refill, up to bluefs_max_prefetch.")
+    .add_see_also("bluefs_max_prefetch")
+    .add_see_also("bluefs_readahead_max_total"),
+
+    Option("bluefs_readahead_max_total", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_M)
+    .set_description("Maximum memory held by the readahead windows of all random-access BlueFS readers")
+    .set_long_description("A reader keeps its window until another read breaks its run or the file is closed, and RocksDB keeps many table files open; reads that would take the total past this limit are not read ahead.")
+    .add_see_also("bluefs_readahead_min"),
+
     Option("bluefs_min_log_runway", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(1_M)
     .set_description(""),
@@ -4392,6 +4533,13 @@ std::vector<Option> get_global_options() {
     .set_description("Allocator policy")
     .set_long_description("Allocator to use for bluestore.  Stupid should only be used for testing."),
 
+    Option("bluestore_alloc_snapshot", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Save allocator free space on clean umount and reload it on mount")
+    .set_long_description("When enabled, a clean umount stores the free extent list in the DB so the next mount can initialize the allocator from it instead of scanning the whole freelist.  The saved state is dropped as soon as the DB is opened for write, so a crash or any offline modification falls back to the full scan.  Releases that do not know about the saved state must not be run against the store between such a umount and the next mount.")
+    .add_see_also("bluestore_allocator"),
+
     Option("bluestore_freelist_blocks_per_key", Option::TYPE_SIZE, Option::LEVEL_DEV)
     .set_default(128)
     .set_description("Block (and bits) per database key"),
@@ -4471,6 +4619,15 @@ std::vector<Option> get_global_options() {
       .set_default(2)
       .set_description("Number of additional threads to perform quick-fix (shallow fsck) command"),
 
+    Option("bluestore_fsck_deep_read_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_description("Number of threads reading object data back during deep fsck")
+    .set_long_description("Object data is verified by these threads while the "
+			  "main thread checks metadata; 0 reads everything "
+			  "from the main thread. Each thread holds up to "
+			  "bluestore_fsck_read_bytes_cap of data at a time.")
+    .add_see_also("bluestore_fsck_read_bytes_cap"),
+
     Option("bluestore_throttle_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(64_M)
     .set_flag(Option::FLAG_RUNTIME)
@@ -4515,6 +4672,38 @@ std::vector<Option> get_global_options() {
     .set_description("Default bluestore_deferred_batch_ops for non-rotational (solid state) media")
     .add_see_also("bluestore_deferred_batch_ops"),
 
+    Option("bluestore_deferred_batch_target_latency", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Target latency (seconds) of a deferred write batch, 0 disables adaptive batching")
+    .set_long_description("When set, the number of deferred writes queued before a flush starts at bluestore_deferred_batch_ops and grows while batches complete faster than this, so that more overwrites and adjacent writes are merged.  It is halved when a batch takes longer.")
+    .add_see_also({"bluestore_deferred_batch_ops", "bluestore_deferred_batch_ops_max"}),
+
+    Option("bluestore_deferred_batch_ops_max", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1024)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Upper bound for the adaptive deferred batch size")
+    .add_see_also("bluestore_deferred_batch_target_latency"),
+
+    Option("bluestore_defrag_bytes_per_sec", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Rate at which fragmented objects are rewritten in the background, 0 disables defragmentation")
+    .set_long_description("Objects whose extent map grows beyond bluestore_defrag_min_extents on write are queued and rewritten into freshly allocated extents.  The released extents coalesce with neighbouring free space in the allocator.  Progress is reported by the bluestore_defrag_* perf counters.")
+    .add_see_also({"bluestore_defrag_min_extents", "bluestore_defrag_max_object_size"}),
+
+    Option("bluestore_defrag_min_extents", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(64)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Minimum number of extents for an object to be defragmented")
+    .add_see_also("bluestore_defrag_bytes_per_sec"),
+
+    Option("bluestore_defrag_max_object_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(4_M)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Objects larger than this are not defragmented")
+    .add_see_also("bluestore_defrag_bytes_per_sec"),
+
     Option("bluestore_nid_prealloc", Option::TYPE_INT, Option::LEVEL_DEV)
     .set_default(1024)
     .set_description("Number of unique object ids to preallocate at a time"),
@@ -4676,6 +4865,25 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description("Enables Linux io_uring API instead of libaio"),
 
+    Option("bdev_ioring_hipri", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Use polled IO completions with io_uring")
+    .set_long_description("The device must support polling (e.g. an NVMe "
+			  "device with poll queues configured); the aio "
+			  "thread busy-polls for completions.")
+    .add_see_also("bluestore_ioring"),
+
+    Option("bdev_ioring_sqthread_poll", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Offload io_uring submission to a kernel polling thread")
+    .set_long_description("Submissions are picked up by a kernel thread "
+			  "without an io_uring_enter(2) call per batch. Falls "
+			  "back to regular submission if the kernel does not "
+			  "allow it for an unprivileged process.")
+    .add_see_also("bluestore_ioring"),
+
     // -----------------------------------------
     // kstore
 
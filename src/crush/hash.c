@@ -2,6 +2,12 @@
 # include <linux/crush/hash.h>
 #else
 # include "hash.h"
+# include "arch/probe.h"
+# include "arch/intel.h"
+#endif
+#if !defined(__KERNEL__) && defined(__x86_64__) && defined(__GNUC__)
+# define CRUSH_HASH_AVX2
+# include <immintrin.h>
 #endif
 
 /*
@@ -140,6 +146,92 @@ __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d, __u32 e)
 	}
 }
 
+#ifndef __KERNEL__
+
+static void crush_hash32_rjenkins1_3_n(__u32 a, const __s32 *b, __u32 c,
+				       __u32 *out, unsigned int n)
+{
+	unsigned int i;
+	for (i = 0; i < n; i++)
+		out[i] = crush_hash32_rjenkins1_3(a, b[i], c);
+}
+
+#ifdef CRUSH_HASH_AVX2
+/*
+ * crush_hashmix on 8 lanes.  the scalar version works mod 2^32 with
+ * logical shifts, which is exactly what the epi32 ops do, so the
+ * results are bit-identical.
+ */
+#define crush_hashmix_avx2(a, b, c) do {				\
+		a = _mm256_sub_epi32(a, b); a = _mm256_sub_epi32(a, c); \
+		a = _mm256_xor_si256(a, _mm256_srli_epi32(c, 13));	\
+		b = _mm256_sub_epi32(b, c); b = _mm256_sub_epi32(b, a); \
+		b = _mm256_xor_si256(b, _mm256_slli_epi32(a, 8));	\
+		c = _mm256_sub_epi32(c, a); c = _mm256_sub_epi32(c, b); \
+		c = _mm256_xor_si256(c, _mm256_srli_epi32(b, 13));	\
+		a = _mm256_sub_epi32(a, b); a = _mm256_sub_epi32(a, c); \
+		a = _mm256_xor_si256(a, _mm256_srli_epi32(c, 12));	\
+		b = _mm256_sub_epi32(b, c); b = _mm256_sub_epi32(b, a); \
+		b = _mm256_xor_si256(b, _mm256_slli_epi32(a, 16));	\
+		c = _mm256_sub_epi32(c, a); c = _mm256_sub_epi32(c, b); \
+		c = _mm256_xor_si256(c, _mm256_srli_epi32(b, 5));	\
+		a = _mm256_sub_epi32(a, b); a = _mm256_sub_epi32(a, c); \
+		a = _mm256_xor_si256(a, _mm256_srli_epi32(c, 3));	\
+		b = _mm256_sub_epi32(b, c); b = _mm256_sub_epi32(b, a); \
+		b = _mm256_xor_si256(b, _mm256_slli_epi32(a, 10));	\
+		c = _mm256_sub_epi32(c, a); c = _mm256_sub_epi32(c, b); \
+		c = _mm256_xor_si256(c, _mm256_srli_epi32(b, 15));	\
+	} while (0)
+
+__attribute__((target("avx2")))
+static void crush_hash32_rjenkins1_3_n_avx2(__u32 a, const __s32 *b, __u32 c,
+					    __u32 *out, unsigned int n)
+{
+	unsigned int i;
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256i va = _mm256_set1_epi32(a);
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i vc = _mm256_set1_epi32(c);
+		__m256i x = _mm256_set1_epi32(231232);
+		__m256i y = _mm256_set1_epi32(1232);
+		__m256i hash = _mm256_xor_si256(
+			_mm256_set1_epi32(crush_hash_seed ^ a ^ c), vb);
+		crush_hashmix_avx2(va, vb, hash);
+		crush_hashmix_avx2(vc, x, hash);
+		crush_hashmix_avx2(y, va, hash);
+		crush_hashmix_avx2(vb, x, hash);
+		crush_hashmix_avx2(y, vc, hash);
+		_mm256_storeu_si256((__m256i *)(out + i), hash);
+	}
+	crush_hash32_rjenkins1_3_n(a, b + i, c, out + i, n - i);
+}
+#endif
+
+void crush_hash32_3_n(int type, __u32 a, const __s32 *b, __u32 c,
+		      __u32 *out, unsigned int n)
+{
+	unsigned int i;
+	switch (type) {
+	case CRUSH_HASH_RJENKINS1:
+#ifdef CRUSH_HASH_AVX2
+		if (!ceph_arch_probed)
+			ceph_arch_probe();
+		if (ceph_arch_intel_avx2) {
+			crush_hash32_rjenkins1_3_n_avx2(a, b, c, out, n);
+			return;
+		}
+#endif
+		crush_hash32_rjenkins1_3_n(a, b, c, out, n);
+		return;
+	default:
+		for (i = 0; i < n; i++)
+			out[i] = 0;
+		return;
+	}
+}
+
+#endif
+
 const char *crush_hash_name(int type)
 {
 	switch (type) {
@@ -331,10 +331,8 @@ static inline __s32 *get_choose_arg_ids(const struct crush_bucket_straw2 *bucket
  * for reference, see the exponential distribution example at:  
  * https://en.wikipedia.org/wiki/Inverse_transform_sampling#Examples
  */
-static inline __s64 generate_exponential_distribution(int type, int x, int y, int z, 
-                                                      int weight)
+static inline __s64 straw2_draw(unsigned int u, int weight)
 {
-	unsigned int u = crush_hash32_3(type, x, y, z);
 	u &= 0xffff;
 
 	/*
@@ -358,6 +356,51 @@ static inline __s64 generate_exponential_distribution(int type, int x, int y, in
 	return div64_s64(ln, weight);
 }
 
+static inline __s64 generate_exponential_distribution(int type, int x, int y, int z, 
+                                                      int weight)
+{
+	return straw2_draw(crush_hash32_3(type, x, y, z), weight);
+}
+
+#ifndef __KERNEL__
+/*
+ * Wide buckets: hash the items a block at a time with the vector hash
+ * (crush_hash32_3_n), then do the draws.  Same draws, same winner as
+ * the item-at-a-time loop below.
+ */
+#define CRUSH_STRAW2_BLOCK 32
+#define CRUSH_STRAW2_BLOCK_MIN 8
+
+static int bucket_straw2_choose_blocks(const struct crush_bucket_straw2 *bucket,
+				       const __u32 *weights, const __s32 *ids,
+				       int x, int r)
+{
+	__u32 u[CRUSH_STRAW2_BLOCK];
+	unsigned int i, j, n, high = 0;
+	__s64 draw, high_draw = 0;
+
+	for (i = 0; i < bucket->h.size; i += n) {
+		n = bucket->h.size - i;
+		if (n > CRUSH_STRAW2_BLOCK)
+			n = CRUSH_STRAW2_BLOCK;
+		crush_hash32_3_n(bucket->h.hash, x, ids + i, r, u, n);
+		for (j = 0; j < n; j++) {
+			if (weights[i + j])
+				draw = straw2_draw(u[j], weights[i + j]);
+			else
+				draw = S64_MIN;
+
+			if (i + j == 0 || draw > high_draw) {
+				high = i + j;
+				high_draw = draw;
+			}
+		}
+	}
+
+	return bucket->h.items[high];
+}
+#endif
+
 static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 				int x, int r, const struct crush_choose_arg *arg,
                                 int position)
@@ -366,6 +409,10 @@ static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 	__s64 draw, high_draw = 0;
         __u32 *weights = get_choose_arg_weights(bucket, arg, position);
         __s32 *ids = get_choose_arg_ids(bucket, arg);
+#ifndef __KERNEL__
+	if (bucket->h.size >= CRUSH_STRAW2_BLOCK_MIN)
+		return bucket_straw2_choose_blocks(bucket, weights, ids, x, r);
+#endif
 	for (i = 0; i < bucket->h.size; i++) {
                 dprintk("weight 0x%x item %d\n", weights[i], ids[i]);
 		if (weights[i]) {
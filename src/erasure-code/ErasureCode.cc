@@ -359,4 +359,25 @@ int ErasureCode::decode_concat(const map<int, bufferlist> &chunks,
   }
   return r;
 }
+
+void ErasureCode::encode_delta(const bufferptr &old_data,
+			       const bufferptr &new_data,
+			       bufferptr *delta)
+{
+  ceph_assert(old_data.length() == new_data.length());
+  ceph_assert(delta->length() == old_data.length());
+  // addition in GF(2^w) is xor, whatever the code
+  const char *o = old_data.c_str();
+  const char *n = new_data.c_str();
+  char *d = delta->c_str();
+  for (unsigned i = 0; i < old_data.length(); ++i) {
+    d[i] = o[i] ^ n[i];
+  }
+}
+
+void ErasureCode::apply_delta(const map<int, bufferptr> &in,
+			      map<int, bufferptr> &out)
+{
+  ceph_abort_msg("parity delta is not supported by this plugin");
+}
 }
@@ -120,6 +120,17 @@ namespace ceph {
     int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) override;
 
+    bool supports_parity_delta() const override {
+      return false;
+    }
+
+    void encode_delta(const bufferptr &old_data,
+		      const bufferptr &new_data,
+		      bufferptr *delta) override;
+
+    void apply_delta(const std::map<int, bufferptr> &in,
+		     std::map<int, bufferptr> &out) override;
+
   protected:
     int parse(const ErasureCodeProfile &profile,
 	      std::ostream *ss);
@@ -459,6 +459,45 @@ namespace ceph {
      */
     virtual int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) = 0;
+
+    /**
+     * Return true if the coding chunks can be updated from the
+     * difference between the old and the new content of some data
+     * chunks, without reading the other data chunks. This holds for
+     * linear codes such as Reed-Solomon, where each coding chunk is a
+     * weighted sum of the data chunks.
+     *
+     * @return **true** if **apply_delta** is implemented
+     */
+    virtual bool supports_parity_delta() const = 0;
+
+    /**
+     * Compute in **delta** the difference between **old_data** and
+     * **new_data**, two versions of the same range of a data chunk.
+     * All three buffers must have the same length. **delta** may be
+     * **old_data** or **new_data**.
+     *
+     * @param [in] old_data current content of the range
+     * @param [in] new_data content about to be written
+     * @param [out] delta difference to pass to **apply_delta**
+     */
+    virtual void encode_delta(const bufferptr &old_data,
+			      const bufferptr &new_data,
+			      bufferptr *delta) = 0;
+
+    /**
+     * Update the coding chunks in **out** with the deltas of the data
+     * chunks in **in**, both keyed by chunk index.  **out** must
+     * contain the same range of every coding chunk and each delta must
+     * cover that same range, zero filled where the data is unchanged.
+     *
+     * Only valid if **supports_parity_delta** returns true.
+     *
+     * @param [in] in map data chunk indexes to deltas
+     * @param [in,out] out map coding chunk indexes to coding data
+     */
+    virtual void apply_delta(const std::map<int, bufferptr> &in,
+			     std::map<int, bufferptr> &out) = 0;
   };
 
   typedef std::shared_ptr<ErasureCodeInterface> ErasureCodeInterfaceRef;
@@ -132,6 +132,34 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+void
+ErasureCodeIsaDefault::apply_delta(const map<int, bufferptr> &in,
+                                   map<int, bufferptr> &out)
+{
+  ceph_assert(out.size() == (unsigned)m);
+  int blocksize = out.begin()->second.length();
+  char *coding[m];
+  for (auto &&i : out) {
+    ceph_assert(i.first >= k && i.first < k + m);
+    ceph_assert((int)i.second.length() == blocksize);
+    coding[i.first - k] = i.second.c_str();
+  }
+  for (auto &&i : in) {
+    ceph_assert(i.first >= 0 && i.first < k);
+    ceph_assert((int)i.second.length() == blocksize);
+    unsigned char *delta = (unsigned char*) i.second.c_str();
+    if (m == 1) {
+      // single parity stripe, see isa_encode
+      byte_xor(delta, (unsigned char*) coding[0], delta + blocksize);
+    } else {
+      ec_encode_data_update(blocksize, k, m, i.first, encode_tbls,
+                            delta, (unsigned char**) coding);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
@@ -134,6 +134,14 @@ public:
                           char **coding,
                           int blocksize) override;
 
+  bool supports_parity_delta() const override
+  {
+    return true;
+  }
+
+  void apply_delta(const std::map<int, ceph::bufferptr> &in,
+                   std::map<int, ceph::bufferptr> &out) override;
+
   virtual bool erasure_contains(int *erasures, int i);
 
   int isa_decode(int *erasures,
@@ -39,6 +39,7 @@ using std::map;
 using std::set;
 
 using ceph::bufferlist;
+using ceph::bufferptr;
 using ceph::ErasureCodeProfile;
 
 static ostream& _prefix(std::ostream* _dout)
@@ -137,6 +138,42 @@ int ErasureCodeJerasure::decode_chunks(const set<int> &want_to_read,
   return jerasure_decode(erasures, data, coding, blocksize);
 }
 
+void ErasureCodeJerasure::matrix_apply_delta(const int *matrix,
+					     const map<int, bufferptr> &in,
+					     map<int, bufferptr> &out)
+{
+  // coding chunk i is the sum of data chunk j times matrix[i * k + j]
+  for (auto &&o : out) {
+    int row = o.first - k;
+    ceph_assert(row >= 0 && row < m);
+    char *coding = o.second.c_str();
+    int blocksize = o.second.length();
+    for (auto &&i : in) {
+      ceph_assert(i.first >= 0 && i.first < k);
+      ceph_assert((int)i.second.length() == blocksize);
+      char *delta = const_cast<char*>(i.second.c_str());
+      int factor = matrix[row * k + i.first];
+      if (factor == 1) {
+	galois_region_xor(delta, coding, blocksize);
+	continue;
+      }
+      switch (w) {
+      case 8:
+	galois_w08_region_multiply(delta, factor, blocksize, coding, 1);
+	break;
+      case 16:
+	galois_w16_region_multiply(delta, factor, blocksize, coding, 1);
+	break;
+      case 32:
+	galois_w32_region_multiply(delta, factor, blocksize, coding, 1);
+	break;
+      default:
+	ceph_abort();
+      }
+    }
+  }
+}
+
 bool ErasureCodeJerasure::is_prime(int value)
 {
   int prime55[] = {
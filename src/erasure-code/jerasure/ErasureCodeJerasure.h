@@ -77,6 +77,9 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ceph::ErasureCodeProfile &profile, std::ostream *ss);
+  void matrix_apply_delta(const int *matrix,
+			  const std::map<int, ceph::bufferptr> &in,
+			  std::map<int, ceph::bufferptr> &out);
 };
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
 public:
@@ -104,6 +107,13 @@ public:
                                int blocksize) override;
   unsigned get_alignment() const override;
   void prepare() override;
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  void apply_delta(const std::map<int, ceph::bufferptr> &in,
+		   std::map<int, ceph::bufferptr> &out) override {
+    matrix_apply_delta(matrix, in, out);
+  }
 private:
   int parse(ceph::ErasureCodeProfile& profile, std::ostream *ss) override;
 };
@@ -134,6 +144,13 @@ public:
                                int blocksize) override;
   unsigned get_alignment() const override;
   void prepare() override;
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  void apply_delta(const std::map<int, ceph::bufferptr> &in,
+		   std::map<int, ceph::bufferptr> &out) override {
+    matrix_apply_delta(matrix, in, out);
+  }
 private:
   int parse(ceph::ErasureCodeProfile& profile, std::ostream *ss) override;
 };
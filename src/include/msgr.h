@@ -52,15 +52,18 @@
 #define DEFINE_MSGR2_FEATURE(bit, incarnation, name)               \
 	const static uint64_t CEPH_MSGR2_FEATURE_##name = (1ULL << bit); \
 	const static uint64_t CEPH_MSGR2_FEATUREMASK_##name =            \
-			(1ULL << bit | CEPH_FEATURE_INCARNATION_##incarnation);
+			(1ULL << bit | CEPH_MSGR2_INCARNATION_##incarnation);
 
 #define HAVE_MSGR2_FEATURE(x, name) \
 	(((x) & (CEPH_MSGR2_FEATUREMASK_##name)) == (CEPH_MSGR2_FEATUREMASK_##name))
 
+// bits 0 and 1 are REVISION_1 and COMPRESSION upstream, whose frame
+// formats differ from ours; keep clear of the low bits
+DEFINE_MSGR2_FEATURE(8, 1, SEGMENT_COMPRESSION)   // on-wire compression
 
-#define CEPH_MSGR2_SUPPORTED_FEATURES (0ull)
+#define CEPH_MSGR2_SUPPORTED_FEATURES (CEPH_MSGR2_FEATURE_SEGMENT_COMPRESSION)
 
-#define CEPH_MSGR2_REQUIRED_FEATURES (CEPH_MSGR2_SUPPORTED_FEATURES)
+#define CEPH_MSGR2_REQUIRED_FEATURES (0ull)
 
 
 /*
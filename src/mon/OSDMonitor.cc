@@ -775,6 +775,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     dout(7) << __func__ << " loading latest full map e" << latest_full << dendl;
     osdmap = OSDMap();
     osdmap.decode(latest_bl);
+    mapping_inc.reset();
   }
 
   bufferlist bl;
@@ -793,6 +794,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
   // walk through incrementals
   MonitorDBStore::TransactionRef t;
   size_t tx_size = 0;
+  bool reloaded = false;  // osdmap was replaced by a canonical full map
   while (version > osdmap.epoch) {
     bufferlist inc_bl;
     int err = get_version(osdmap.epoch+1, inc_bl);
@@ -857,6 +859,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
 
 	osdmap = OSDMap();
 	osdmap.decode(orig_full_bl);
+	reloaded = true;
 
 	dout(20) << __func__ << " canonical full osdmap:\n";
 	JSONFormatter jf(true);
@@ -894,6 +897,13 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
 	osd_epochs.erase(osd_state.first);
       }
     }
+    // keep the last incremental so the next mapping update can be a delta,
+    // unless the map it would apply to was replaced wholesale
+    if (reloaded) {
+      mapping_inc.reset();
+    } else {
+      mapping_inc = std::make_unique<OSDMap::Incremental>(std::move(inc));
+    }
   }
 
   if (t) {
@@ -1020,10 +1030,25 @@ void OSDMonitor::start_mapping()
   }
   if (!osdmap.get_pools().empty()) {
     auto fin = new C_UpdateCreatingPGs(this, osdmap.get_epoch());
-    mapping_job = mapping.start_update(osdmap, mapper,
-				       g_conf()->mon_osd_mapping_pgs_per_chunk);
-    dout(10) << __func__ << " started mapping job " << mapping_job.get()
-	     << " at " << fin->start << dendl;
+    if (mapping_inc && mapping_inc->epoch == osdmap.get_epoch()) {
+      mapping_job = mapping.start_update(
+	osdmap, *mapping_inc, mapper,
+	g_conf()->mon_osd_mapping_pgs_per_chunk);
+    } else {
+      mapping_job = mapping.start_update(
+	osdmap, mapper,
+	g_conf()->mon_osd_mapping_pgs_per_chunk);
+    }
+    if (mapping.get_full_reason().empty()) {
+      dout(10) << __func__ << " started mapping job " << mapping_job.get()
+	       << " at " << fin->start << " for "
+	       << mapping.get_last_update_pgs() << " changed pgs" << dendl;
+    } else {
+      dout(10) << __func__ << " started mapping job " << mapping_job.get()
+	       << " at " << fin->start << " for all "
+	       << mapping.get_last_update_pgs() << " pgs: "
+	       << mapping.get_full_reason() << dendl;
+    }
     mapping_job->set_finish_event(fin);
   } else {
     dout(10) << __func__ << " no pools, no mapping job" << dendl;
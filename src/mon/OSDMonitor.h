@@ -390,6 +390,7 @@ private:
   ParallelPGMapper mapper;                        ///< for background pg work
   OSDMapMapping mapping;                          ///< pg <-> osd mappings
   std::unique_ptr<ParallelPGMapper::Job> mapping_job;  ///< background mapping job
+  std::unique_ptr<OSDMap::Incremental> mapping_inc;  ///< last applied incremental
   void start_mapping();
 
   void update_logger();
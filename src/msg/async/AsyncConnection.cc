@@ -62,6 +62,16 @@ class C_time_wakeup : public EventCallback {
   }
 };
 
+class C_deferred_flush : public EventCallback {
+  AsyncConnectionRef conn;
+
+ public:
+  explicit C_deferred_flush(AsyncConnectionRef c): conn(c) {}
+  void do_request(uint64_t id) override {
+    conn->deferred_flush(id);
+  }
+};
+
 class C_handle_read : public EventCallback {
   AsyncConnectionRef conn;
 
@@ -134,6 +144,7 @@ AsyncConnection::AsyncConnection(CephContext *cct, AsyncMessenger *m, DispatchQu
   write_callback_handler = new C_handle_write_callback(this);
   wakeup_handler = new C_time_wakeup(this);
   tick_handler = new C_tick_wakeup(this);
+  flush_handler = new C_deferred_flush(this);
   // double recv_max_prefetch see "read_until"
   recv_buf = new char[2*recv_max_prefetch];
   if (local) {
@@ -327,11 +338,24 @@ ssize_t AsyncConnection::_try_send(bool more)
   ceph_assert(center->in_thread());
   ldout(async_msgr->cct, 25) << __func__ << " cs.send " << outgoing_bl.length()
                              << " bytes" << dendl;
+  if (outgoing_bl.length()) {
+    logger->inc(l_msgr_send_syscalls);
+    if (outgoing_messages) {
+      logger->inc(l_msgr_send_batch_messages, outgoing_messages);
+      logger->inc(l_msgr_send_batch_bytes, outgoing_bl.length());
+      outgoing_messages = 0;
+    }
+    last_send = ceph::coarse_mono_clock::now();
+  }
+  const auto len = outgoing_bl.length();
   ssize_t r = cs.send(outgoing_bl, more);
   if (r < 0) {
     ldout(async_msgr->cct, 1) << __func__ << " send error: " << cpp_strerror(r) << dendl;
     return r;
   }
+  // whoever ends up flushing them (a message, an ack, a deferred flush
+  // or a writable socket), every byte is counted when it is sent
+  logger->inc(l_msgr_send_bytes, len - outgoing_bl.length());
 
   ldout(async_msgr->cct, 10) << __func__ << " sent bytes " << r
                              << " remaining bytes " << outgoing_bl.length() << dendl;
@@ -352,6 +376,63 @@ ssize_t AsyncConnection::_try_send(bool more)
   return outgoing_bl.length();
 }
 
+// Resolution of the EventCenter timers, which run on coarse_mono_clock
+static ceph::timespan timer_resolution()
+{
+  static const ceph::timespan res = [] {
+    struct timespec ts = {0, 1000000};
+#if defined(CLOCK_MONOTONIC_COARSE)
+    clock_getres(CLOCK_MONOTONIC_COARSE, &ts);
+#elif defined(CLOCK_MONOTONIC_FAST)
+    clock_getres(CLOCK_MONOTONIC_FAST, &ts);
+#endif
+    return ceph::make_timespan(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+  }();
+  return res;
+}
+
+// Like _try_send(), for message frames: instead of a socket write per
+// message, frames are coalesced while more are queued behind them (up to
+// ms_async_batch_max_bytes).  With ms_async_batch_window_us, a connection
+// that wrote less than a window ago also holds the last one back until
+// the window ends; windows shorter than the timers' resolution can't be
+// honoured and are ignored.  Returns 0 when the frames were kept for later.
+ssize_t AsyncConnection::_try_send_batched(bool more)
+{
+  ceph_assert(center->in_thread());
+  const auto& conf = async_msgr->cct->_conf;
+  if (!outgoing_bl.length() ||
+      outgoing_bl.length() >= conf->ms_async_batch_max_bytes) {
+    return _try_send(more);
+  }
+  if (more || flush_timer_id) {
+    return 0;
+  }
+  const auto window = std::chrono::microseconds(conf->ms_async_batch_window_us);
+  // measured on the timers' clock, so that a timer armed for the rest of
+  // the window always finds it over when it fires
+  const auto since = ceph::coarse_mono_clock::now() - last_send;
+  if (window < timer_resolution() || since >= window) {
+    // idle, or no window: don't add latency
+    return _try_send();
+  }
+  logger->inc(l_msgr_send_deferred);
+  flush_timer_id = center->create_time_event(
+    std::chrono::duration_cast<std::chrono::microseconds>(
+      window - since).count() + 1,
+    flush_handler);
+  return 0;
+}
+
+void AsyncConnection::deferred_flush(uint64_t id)
+{
+  ldout(async_msgr->cct, 20) << __func__ << " id=" << id << dendl;
+  if (flush_timer_id == id) {
+    flush_timer_id = 0;
+  }
+  handle_write();
+}
+
 void AsyncConnection::inject_delay() {
   if (async_msgr->cct->_conf->ms_inject_internal_delays) {
     ldout(async_msgr->cct, 10) << __func__ << " sleep for " <<
@@ -369,6 +450,11 @@ void AsyncConnection::process() {
 
   ldout(async_msgr->cct, 20) << __func__ << dendl;
 
+  if (cs) {
+    // zero-copy send completions arrive as socket errors
+    cs.reap_send_completions();
+  }
+
   switch (state) {
     case STATE_NONE: {
       ldout(async_msgr->cct, 20) << __func__ << " enter none state" << dendl;
@@ -395,6 +481,9 @@ void AsyncConnection::process() {
       SocketOptions opts;
       opts.priority = async_msgr->get_socket_priority();
       opts.connect_bind_addr = msgr->get_myaddrs().front();
+      if (async_msgr->cct->_conf->ms_tcp_zerocopy) {
+        opts.zerocopy_min_size = async_msgr->cct->_conf->ms_tcp_zerocopy_min_size;
+      }
       ssize_t r = worker->connect(target_addr, opts, &cs);
       if (r < 0) {
         protocol->fault();
@@ -624,6 +713,10 @@ void AsyncConnection::shutdown_socket() {
     center->delete_time_event(last_tick_id);
     last_tick_id = 0;
   }
+  if (flush_timer_id) {
+    center->delete_time_event(flush_timer_id);
+    flush_timer_id = 0;
+  }
   if (cs) {
     center->delete_file_event(cs.fd(), EVENT_READABLE | EVENT_WRITABLE);
     cs.shutdown();
@@ -740,6 +833,7 @@ void AsyncConnection::cleanup() {
   delete write_callback_handler;
   delete wakeup_handler;
   delete tick_handler;
+  delete flush_handler;
   if (delay_state) {
     delete delay_state;
     delay_state = NULL;
@@ -59,6 +59,7 @@ class AsyncConnection : public Connection {
   ssize_t write(ceph::buffer::list &bl, std::function<void(ssize_t)> callback,
                 bool more=false);
   ssize_t _try_send(bool more=false);
+  ssize_t _try_send_batched(bool more);
 
   void _connect();
   void _stop();
@@ -185,6 +186,11 @@ private:
   ceph::buffer::list outgoing_bl;
   bool open_write = false;
 
+  // batching of outgoing messages, see _try_send_batched()
+  unsigned outgoing_messages = 0;  ///< messages appended since last send
+  ceph::coarse_mono_clock::time_point last_send;  ///< on the timers' clock
+  uint64_t flush_timer_id = 0;
+
   std::mutex write_lock;
 
   std::mutex lock;
@@ -193,6 +199,7 @@ private:
   EventCallbackRef write_callback_handler;
   EventCallbackRef wakeup_handler;
   EventCallbackRef tick_handler;
+  EventCallbackRef flush_handler;
   char *recv_buf;
   uint32_t recv_max_prefetch;
   uint32_t recv_start;
@@ -233,6 +240,7 @@ private:
   void process();
   void wakeup_from(uint64_t id);
   void tick(uint64_t id);
+  void deferred_flush(uint64_t id);
   void local_deliver();
   void stop(bool queue_reset);
   void cleanup();
@@ -175,6 +175,9 @@ void Processor::accept()
   opts.nodelay = msgr->cct->_conf->ms_tcp_nodelay;
   opts.rcbuf_size = msgr->cct->_conf->ms_tcp_rcvbuf;
   opts.priority = msgr->get_socket_priority();
+  if (msgr->cct->_conf->ms_tcp_zerocopy) {
+    opts.zerocopy_min_size = msgr->cct->_conf->ms_tcp_zerocopy_min_size;
+  }
 
   for (auto& listen_socket : listen_sockets) {
     ldout(msgr->cct, 10) << __func__ << " listen_fd=" << listen_socket.fd()
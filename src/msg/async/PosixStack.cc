@@ -16,11 +16,15 @@
 
 #include <sys/socket.h>
 #include <netinet/tcp.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
 
 #include <algorithm>
+#include <map>
 
 #include "PosixStack.h"
 
@@ -43,10 +47,30 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   entity_addr_t sa;
   bool connected;
 
+  // MSG_ZEROCOPY: sends of at least zc_min_size bytes are not copied by
+  // the kernel, so their buffers are parked in zc_pending, keyed by the
+  // kernel's per-socket send id, until the completion for that id shows
+  // up on the socket's error queue.
+  unsigned zc_min_size = 0;
+  uint32_t zc_next_id = 0;
+  std::map<uint32_t, ceph::buffer::list> zc_pending;
+
+  /// (zerocopy id or -1, bytes) of each successful sendmsg in a send()
+  std::vector<std::pair<int64_t, size_t>> zc_sends;
+
  public:
   explicit PosixConnectedSocketImpl(ceph::NetHandler &h, const entity_addr_t &sa,
-				    int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+				    int f, bool connected,
+				    unsigned zerocopy_min_size = 0)
+      : handler(h), _fd(f), sa(sa), connected(connected) {
+#ifdef SO_ZEROCOPY
+    int on = 1;
+    if (zerocopy_min_size &&
+	::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0) {
+      zc_min_size = zerocopy_min_size;
+    }
+#endif
+  }
 
   int is_connected() override {
     if (connected)
@@ -72,22 +96,33 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   // return the sent length
   // < 0 means error occurred
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  ssize_t do_sendmsg(struct msghdr &msg, unsigned len, bool more, bool zerocopy)
   {
     size_t sent = 0;
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+#ifdef MSG_ZEROCOPY
+      if (zerocopy) {
+	flags |= MSG_ZEROCOPY;
+      }
+#endif
+      r = ::sendmsg(_fd, &msg, flags);
       if (r < 0) {
         if (errno == EINTR) {
           continue;
         } else if (errno == EAGAIN) {
           break;
-        }
+        } else if (zerocopy && errno == ENOBUFS) {
+	  // out of optmem for completion notifications; copy this one
+	  zerocopy = false;
+	  continue;
+	}
         return -errno;
       }
 
+      zc_sends.emplace_back(zerocopy ? zc_next_id++ : -1, r);
       sent += r;
       if (len == sent) break;
 
@@ -108,6 +143,9 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t send(ceph::buffer::list &bl, bool more) override {
+    reap_send_completions();
+    const bool zerocopy = zc_min_size && bl.length() >= zc_min_size;
+    zc_sends.clear();
     size_t sent_bytes = 0;
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = bl.get_num_buffers();
@@ -127,7 +165,7 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      ssize_t r = do_sendmsg(msg, msglen, left_pbrs || more, zerocopy);
       if (r < 0)
         return r;
 
@@ -138,7 +176,17 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
       // only "r" == 0 continue
     }
 
-    if (sent_bytes) {
+    if (zerocopy) {
+      // the kernel still references what it sent; hand each sendmsg's
+      // worth of buffers over to zc_pending instead of dropping them
+      for (const auto& [id, len] : zc_sends) {
+	ceph::buffer::list sent;
+	bl.splice(0, len, &sent);
+	if (id >= 0) {
+	  zc_pending[static_cast<uint32_t>(id)] = std::move(sent);
+	}
+      }
+    } else if (sent_bytes) {
       ceph::buffer::list swapped;
       if (sent_bytes < bl.length()) {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
@@ -150,11 +198,56 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
     return static_cast<ssize_t>(sent_bytes);
   }
+  void reap_send_completions() override {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    while (!zc_pending.empty()) {
+      char control[128];
+      struct msghdr msg = {};
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+	break;
+      }
+      for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+	if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+	    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+	  continue;
+	}
+	auto serr = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+	if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+	  continue;
+	}
+	// completions cover the inclusive id range [ee_info, ee_data]
+	for (uint32_t id = serr->ee_info; ; ++id) {
+	  zc_pending.erase(id);
+	  if (id == serr->ee_data) {
+	    break;
+	  }
+	}
+	if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+	  // the device (or loopback) copied anyway, so pinning pages
+	  // only costs us; stop asking for it on this socket
+	  zc_min_size = 0;
+	}
+      }
+    }
+#endif
+  }
   void shutdown() override {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+    reap_send_completions();
+    if (!zc_pending.empty()) {
+      // the kernel may still transmit from these pages after a normal
+      // close, and they are about to be freed and reused.  Abort the
+      // connection instead, so that the unsent data is dropped rather
+      // than sent with whatever ends up in those pages.
+      struct linger l = { 1, 0 };
+      ::setsockopt(_fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+    }
     ::close(_fd);
+    zc_pending.clear();
   }
   int fd() const override {
     return _fd;
@@ -209,7 +302,8 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(
+    handler, *out, sd, true, opt.zerocopy_min_size));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -278,7 +372,8 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(
+        net, addr, sd, !opts.nonblock, opts.zerocopy_min_size)));
   return 0;
 }
 
@@ -81,6 +81,7 @@ if(connection->interceptor) { \
 ProtocolV2::ProtocolV2(AsyncConnection *connection)
     : Protocol(2, connection),
       state(NONE),
+      peer_supported_features(0),
       peer_required_features(0),
       client_cookie(0),
       server_cookie(0),
@@ -93,12 +94,42 @@ ProtocolV2::ProtocolV2(AsyncConnection *connection)
       can_write(false),
       bannerExchangeCallback(nullptr),
       next_tag(static_cast<Tag>(0)),
+      next_preamble_flags(0),
       keepalive(false) {
 }
 
 ProtocolV2::~ProtocolV2() {
 }
 
+std::optional<uint32_t> ProtocolV2::get_rx_data_off(std::size_t idx) {
+  if (next_tag != Tag::MESSAGE || idx != SegmentIndex::Msg::DATA ||
+      (next_preamble_flags & FRAME_EARLY_SEGMENT_COMPRESSED(idx)) ||
+      rx_segments_data[SegmentIndex::Msg::HEADER].length() <
+        sizeof(ceph_msg_header2)) {
+    return std::nullopt;
+  }
+  const auto& header = reinterpret_cast<const ceph_msg_header2&>(
+    *rx_segments_data[SegmentIndex::Msg::HEADER].c_str());
+  return header.data_off;
+}
+
+ceph::bufferptr ProtocolV2::alloc_data_segment(unsigned len, unsigned off) {
+  // same layout as ProtocolV1: the first bytes, up to the page boundary
+  // implied by off, go at the tail of a page of their own
+  unsigned head = 0;
+  unsigned alloc_len = len;
+  if (off & ~CEPH_PAGE_MASK) {
+    head = std::min<unsigned>(CEPH_PAGE_SIZE - (off & ~CEPH_PAGE_MASK), len);
+    alloc_len += CEPH_PAGE_SIZE;
+  }
+  ceph::bufferptr ptr(ceph::buffer::create_small_page_aligned(alloc_len));
+  if (head) {
+    ptr.set_offset(CEPH_PAGE_SIZE - head);
+    ptr.set_length(len);
+  }
+  return ptr;
+}
+
 void ProtocolV2::connect() {
   ldout(cct, 1) << __func__ << dendl;
   state = START_CONNECT;
@@ -228,6 +259,8 @@ void ProtocolV2::reset_security() {
   auth_meta.reset(new AuthConnectionMeta);
   session_stream_handlers.rx.reset(nullptr);
   session_stream_handlers.tx.reset(nullptr);
+  session_compression_handlers.rx.reset(nullptr);
+  session_compression_handlers.tx.reset(nullptr);
   pre_auth.rxbuf.clear();
   pre_auth.txbuf.clear();
 }
@@ -267,7 +300,9 @@ size_t ProtocolV2::get_current_msg_size() const {
   size_t sum = 0;
   // we don't include SegmentIndex::Msg::HEADER.
   for (__u8 idx = 1; idx < rx_segments_desc.size(); idx++) {
-    sum += rx_segments_desc[idx].length;
+    // compressed segments are charged what they will take decompressed
+    sum += (next_preamble_flags & FRAME_EARLY_SEGMENT_COMPRESSED(idx)) ?
+      rx_segments_raw_len[idx] : rx_segments_desc[idx].length;
   }
   return sum;
 }
@@ -533,7 +568,24 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
 			     m->get_payload(),
 			     m->get_middle(),
 			     m->get_data());
+  if (session_compression_handlers.tx) {
+    const uint64_t raw_len =
+      message.front_len() + message.middle_len() + message.data_len();
+    if (raw_len >= session_compression_handlers.tx->get_min_size()) {
+      const auto start = ceph::mono_clock::now();
+      if (message.compress(*session_compression_handlers.tx)) {
+	connection->logger->inc(l_msgr_send_compressed_messages);
+	connection->logger->inc(l_msgr_send_compressed_raw_bytes, raw_len);
+	connection->logger->inc(
+	  l_msgr_send_compressed_bytes,
+	  message.front_len() + message.middle_len() + message.data_len());
+      }
+      connection->logger->tinc(l_msgr_compress_lat,
+			       ceph::mono_clock::now() - start);
+    }
+  }
   connection->outgoing_bl.append(message.get_buffer(session_stream_handlers));
+  connection->outgoing_messages++;
 
   ldout(cct, 5) << __func__ << " sending message m=" << m
                 << " seq=" << m->get_seq() << " " << *m << dendl;
@@ -543,14 +595,11 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
                  << " src=" << entity_name_t(messenger->get_myname())
                  << " off=" << header2.data_off
                  << dendl;
-  ssize_t total_send_size = connection->outgoing_bl.length();
-  ssize_t rc = connection->_try_send(more);
+  ssize_t rc = connection->_try_send_batched(more);
   if (rc < 0) {
     ldout(cct, 1) << __func__ << " error sending " << m << ", "
                   << cpp_strerror(rc) << dendl;
   } else {
-    connection->logger->inc(
-        l_msgr_send_bytes, total_send_size - connection->outgoing_bl.length());
     ldout(cct, 10) << __func__ << " sending " << m
                    << (rc ? " continuely." : " done.") << dendl;
   }
@@ -669,9 +718,9 @@ void ProtocolV2::write_event() {
                        << " messages" << dendl;
         ack_left -= left;
         left = ack_left;
-        r = connection->_try_send(left);
+        r = connection->_try_send_batched(left);
       } else if (is_queued()) {
-        r = connection->_try_send();
+        r = connection->_try_send_batched(false);
       }
     }
     connection->write_lock.unlock();
@@ -920,6 +969,7 @@ CtPtr ProtocolV2::_handle_peer_banner_payload(rx_buffer_t &&buffer, int r) {
     return nullptr;
   }
 
+  this->peer_supported_features = peer_supported_features;
   this->peer_required_features = peer_required_features;
   if (this->peer_required_features == 0) {
     this->connection_features = msgr2_required;
@@ -1103,6 +1153,7 @@ CtPtr ProtocolV2::handle_read_frame_preamble_main(rx_buffer_t &&buffer, int r) {
     }
 
     next_tag = static_cast<Tag>(main_preamble.tag);
+    next_preamble_flags = main_preamble.flags;
 
     rx_segments_desc.clear();
     rx_segments_data.clear();
@@ -1128,6 +1179,10 @@ CtPtr ProtocolV2::handle_read_frame_preamble_main(rx_buffer_t &&buffer, int r) {
       lderr(cct) << __func__ << " not in ready state!" << dendl;
       return _fault();
     }
+    if (next_preamble_flags & FRAME_EARLY_COMPRESSED_MASK) {
+      // the lengths to throttle on come with the header segment
+      return read_frame_segment();
+    }
     state = THROTTLE_MESSAGE;
     return CONTINUE(throttle_message);
   } else {
@@ -1159,6 +1214,8 @@ CtPtr ProtocolV2::handle_read_frame_dispatch() {
     case Tag::KEEPALIVE2_ACK:
     case Tag::ACK:
     case Tag::WAIT:
+    case Tag::SEGMENT_COMPRESSION_REQUEST:
+    case Tag::SEGMENT_COMPRESSION_DONE:
       return handle_frame_payload();
     case Tag::MESSAGE:
       return handle_message();
@@ -1178,11 +1235,21 @@ CtPtr ProtocolV2::read_frame_segment() {
   ceph_assert(!rx_segments_desc.empty());
 
   // description of current segment to read
-  const auto& cur_rx_desc = rx_segments_desc.at(rx_segments_data.size());
+  const auto idx = rx_segments_data.size();
+  const auto& cur_rx_desc = rx_segments_desc.at(idx);
   rx_buffer_t rx_buffer;
   try {
-    rx_buffer = ceph::buffer::ptr_node::create(ceph::buffer::create_aligned(
-      get_onwire_size(cur_rx_desc.length), cur_rx_desc.alignment));
+    if (const auto data_off = get_rx_data_off(idx); data_off) {
+      // like v1, read the data straight into place so that the byte at
+      // logical offset data_off lands on a page boundary (e.g. the write
+      // payload in MOSDRepOp's transaction) and nobody has to rebuild it.
+      // In secure mode it is decrypted in place, keeping the layout.
+      rx_buffer = ceph::buffer::ptr_node::create(alloc_data_segment(
+	get_onwire_size(cur_rx_desc.length), *data_off));
+    } else {
+      rx_buffer = ceph::buffer::ptr_node::create(ceph::buffer::create_aligned(
+	get_onwire_size(cur_rx_desc.length), cur_rx_desc.alignment));
+    }
   } catch (std::bad_alloc&) {
     // Catching because of potential issues with satisfying alignment.
     ldout(cct, 20) << __func__ << " can't allocate aligned rx_buffer "
@@ -1214,9 +1281,13 @@ CtPtr ProtocolV2::handle_read_frame_segment(rx_buffer_t &&rx_buffer, int r) {
 
     auto& new_seg = rx_segments_data.back();
     if (new_seg.length()) {
-      auto padded = session_stream_handlers.rx->authenticated_decrypt_update(
-          std::move(new_seg), segment_t::DEFAULT_ALIGNMENT);
+      // the buffer already has the alignment (or data_off layout) the
+      // segment asks for; the handler decrypts in place to keep it
       const auto idx = rx_segments_data.size() - 1;
+      const auto alignment = get_rx_data_off(idx) ?
+	1u : rx_segments_desc[idx].alignment;
+      auto padded = session_stream_handlers.rx->authenticated_decrypt_update(
+          std::move(new_seg), alignment);
       new_seg.clear();
       padded.splice(0, rx_segments_desc[idx].length, &new_seg);
 
@@ -1226,6 +1297,15 @@ CtPtr ProtocolV2::handle_read_frame_segment(rx_buffer_t &&rx_buffer, int r) {
     }
   }
 
+  if (next_tag == Tag::MESSAGE && state == READY) {
+    // header segment of a message with compressed segments
+    if (!handle_compression_header()) {
+      return _fault();
+    }
+    state = THROTTLE_MESSAGE;
+    return CONTINUE(throttle_message);
+  }
+
   if (rx_segments_desc.size() == rx_segments_data.size()) {
     // OK, all segments planned to read are read. Can go with epilogue.
     return READ(get_epilogue_size(), handle_read_frame_epilogue_main);
@@ -1282,6 +1362,10 @@ CtPtr ProtocolV2::handle_frame_payload() {
       return handle_message_ack(payload);
     case Tag::WAIT:
       return handle_wait(payload);
+    case Tag::SEGMENT_COMPRESSION_REQUEST:
+      return handle_compression_request(payload);
+    case Tag::SEGMENT_COMPRESSION_DONE:
+      return handle_compression_done(payload);
     default:
       ceph_abort();
   }
@@ -1400,11 +1484,25 @@ CtPtr ProtocolV2::handle_message() {
 
   // we need to get the size before std::moving segments data
   const size_t cur_msg_size = get_current_msg_size();
+  if (next_preamble_flags & FRAME_EARLY_COMPRESSED_MASK) {
+    if (!decompress_segments()) {
+      return _fault();
+    }
+  }
   auto msg_frame = MessageFrame::Decode(std::move(rx_segments_data));
 
   // XXX: paranoid copy just to avoid oops
   ceph_msg_header2 current_header = msg_frame.header();
 
+  if (msg_frame.data_len() &&
+      (next_preamble_flags &
+       FRAME_EARLY_SEGMENT_COMPRESSED(SegmentIndex::Msg::DATA))) {
+    // decompressed into a buffer of its own, so data_off wasn't
+    // honoured; the consumer may have to copy it once more
+    connection->logger->inc(l_msgr_recv_unaligned_data_bytes,
+			    msg_frame.data_len());
+  }
+
   ldout(cct, 5) << __func__
 		<< " got " << msg_frame.front_len()
 		<< " + " << msg_frame.middle_len()
@@ -1660,6 +1758,55 @@ CtPtr ProtocolV2::throttle_dispatch_queue() {
   return read_frame_segment();
 }
 
+bool ProtocolV2::handle_compression_header() {
+  const auto& hdr = rx_segments_data[SegmentIndex::Msg::HEADER];
+  const auto compressed = next_preamble_flags & FRAME_EARLY_COMPRESSED_MASK;
+  if (!session_compression_handlers.rx ||
+      (compressed & FRAME_EARLY_SEGMENT_COMPRESSED(SegmentIndex::Msg::HEADER)) ||
+      (compressed >> rx_segments_desc.size()) ||
+      hdr.length() !=
+        sizeof(ceph_msg_header2) + sizeof(compression_header_t)) {
+    ldout(cct, 1) << __func__ << " bad compressed frame"
+		  << " flags=" << std::hex << (int)next_preamble_flags << std::dec
+		  << " num_segments=" << rx_segments_desc.size()
+		  << " header len=" << hdr.length() << dendl;
+    return false;
+  }
+  compression_header_t ch;
+  hdr.cbegin(sizeof(ceph_msg_header2)).copy(sizeof(ch),
+					    reinterpret_cast<char*>(&ch));
+  for (std::size_t idx = 0; idx < rx_segments_raw_len.size(); idx++) {
+    rx_segments_raw_len[idx] = ch.raw_lengths[idx];
+  }
+  return true;
+}
+
+bool ProtocolV2::decompress_segments() {
+  if (!session_compression_handlers.rx) {
+    ldout(cct, 1) << __func__ << " got compressed segments"
+		  << " flags=" << std::hex << (int)next_preamble_flags << std::dec
+		  << " but compression was not negotiated" << dendl;
+    return false;
+  }
+  const auto start = ceph::mono_clock::now();
+  for (std::size_t idx = 0; idx < rx_segments_data.size(); idx++) {
+    if ((next_preamble_flags & FRAME_EARLY_SEGMENT_COMPRESSED(idx)) &&
+	!session_compression_handlers.rx->decompress(
+	  rx_segments_data[idx], rx_segments_raw_len[idx])) {
+      // the throttles were charged the declared length; anything else
+      // would leave them unbalanced when the message is released
+      ldout(cct, 1) << __func__ << " failed to decompress segment " << idx
+		    << " to declared length " << rx_segments_raw_len[idx]
+		    << dendl;
+      return false;
+    }
+  }
+  connection->logger->inc(l_msgr_recv_compressed_messages);
+  connection->logger->tinc(l_msgr_decompress_lat,
+			   ceph::mono_clock::now() - start);
+  return true;
+}
+
 CtPtr ProtocolV2::handle_keepalive2(ceph::bufferlist &payload)
 {
   ldout(cct, 20) << __func__
@@ -1885,6 +2032,49 @@ CtPtr ProtocolV2::handle_auth_done(ceph::bufferlist &payload)
   return WRITE(sig_frame, "auth signature", read_frame);
 }
 
+CtPtr ProtocolV2::send_compression_request() {
+  state = COMPRESSION_CONNECTING;
+
+  const bool is_compress = ceph::compression::onwire::want_compression(
+    cct, messenger->get_mytype(), connection->get_peer_type(),
+    auth_meta->is_mode_secure());
+  std::vector<uint32_t> methods;
+  if (is_compress) {
+    methods = ceph::compression::onwire::get_preferred_methods(cct);
+  }
+  ldout(cct, 20) << __func__ << " is_compress=" << is_compress
+		 << " methods=" << methods << dendl;
+
+  auto request = CompressionRequestFrame::Encode(is_compress, methods);
+  return WRITE(request, "compression request", read_frame);
+}
+
+CtPtr ProtocolV2::handle_compression_done(ceph::bufferlist &payload)
+{
+  ldout(cct, 20) << __func__
+		 << " payload.length()=" << payload.length() << dendl;
+
+  if (state != COMPRESSION_CONNECTING) {
+    lderr(cct) << __func__ << " not in compression connect state!" << dendl;
+    return _fault();
+  }
+
+  auto response = CompressionDoneFrame::Decode(payload);
+  const uint32_t method = response.is_compress() ?
+    response.method() : static_cast<uint32_t>(Compressor::COMP_ALG_NONE);
+  ldout(cct, 5) << __func__ << " compression method "
+		<< Compressor::get_comp_alg_name(method) << dendl;
+  session_compression_handlers =
+    ceph::compression::onwire::rxtx_t::create_handler_pair(
+      cct, method, ceph::compression::onwire::get_min_size(cct));
+  if (method != Compressor::COMP_ALG_NONE &&
+      !session_compression_handlers.rx) {
+    // the server picked one of our methods, we must be able to honor it
+    return _fault();
+  }
+  return finish_client_auth();
+}
+
 CtPtr ProtocolV2::finish_client_auth() {
   if (!server_cookie) {
     ceph_assert(connect_seq == 0);
@@ -2308,17 +2498,60 @@ CtPtr ProtocolV2::handle_auth_signature(ceph::bufferlist &payload)
 
   if (state == AUTH_ACCEPTING_SIGN) {
     // server had sent AuthDone and client responded with correct pre-auth
-    // signature. we can start accepting new sessions/reconnects.
-    state = SESSION_ACCEPTING;
+    // signature. we can start accepting new sessions/reconnects, possibly
+    // after the peer negotiated compression.
+    if (HAVE_MSGR2_FEATURE(peer_supported_features, SEGMENT_COMPRESSION)) {
+      state = COMPRESSION_ACCEPTING;
+    } else {
+      state = SESSION_ACCEPTING;
+    }
     return CONTINUE(read_frame);
   } else if (state == AUTH_CONNECTING_SIGN) {
     // this happened at client side
+    if (HAVE_MSGR2_FEATURE(peer_supported_features, SEGMENT_COMPRESSION)) {
+      return send_compression_request();
+    }
     return finish_client_auth();
   } else {
     ceph_abort("state corruption");
   }
 }
 
+CtPtr ProtocolV2::handle_compression_request(ceph::bufferlist &payload)
+{
+  ldout(cct, 20) << __func__
+		 << " payload.length()=" << payload.length() << dendl;
+
+  if (state != COMPRESSION_ACCEPTING) {
+    lderr(cct) << __func__ << " not in compression accept state!" << dendl;
+    return _fault();
+  }
+
+  auto request = CompressionRequestFrame::Decode(payload);
+  uint32_t method = Compressor::COMP_ALG_NONE;
+  if (request.is_compress() &&
+      ceph::compression::onwire::want_compression(
+	cct, messenger->get_mytype(), connection->get_peer_type(),
+	auth_meta->is_mode_secure())) {
+    method = ceph::compression::onwire::pick_method(
+      cct, request.preferred_methods());
+  }
+  ldout(cct, 5) << __func__ << " peer methods=" << request.preferred_methods()
+		<< " picked " << Compressor::get_comp_alg_name(method) << dendl;
+
+  session_compression_handlers =
+    ceph::compression::onwire::rxtx_t::create_handler_pair(
+      cct, method, ceph::compression::onwire::get_min_size(cct));
+  if (!session_compression_handlers.tx) {
+    method = Compressor::COMP_ALG_NONE;
+  }
+
+  state = SESSION_ACCEPTING;
+  auto response = CompressionDoneFrame::Encode(
+    method != Compressor::COMP_ALG_NONE, method);
+  return WRITE(response, "compression done", read_frame);
+}
+
 CtPtr ProtocolV2::handle_client_ident(ceph::bufferlist &payload)
 {
   ldout(cct, 20) << __func__
@@ -2717,6 +2950,7 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
   // this happens in the event center's thread as there should be
   // no user outside its boundaries (simlarly to e.g. outgoing_bl).
   auto temp_stream_handlers = std::move(session_stream_handlers);
+  auto temp_compression_handlers = std::move(session_compression_handlers);
   exproto->auth_meta = auth_meta;
 
   ldout(messenger->cct, 5) << __func__ << " stop myself to swap existing"
@@ -2746,7 +2980,8 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
         new_worker,
         new_center,
         exproto,
-        temp_stream_handlers=std::move(temp_stream_handlers)
+        temp_stream_handlers=std::move(temp_stream_handlers),
+        temp_compression_handlers=std::move(temp_compression_handlers)
       ](ConnectedSocket &cs) mutable {
         // we need to delete time event in original thread
         {
@@ -2761,6 +2996,8 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
           existing->outgoing_bl.clear();
           existing->open_write = false;
           exproto->session_stream_handlers = std::move(temp_stream_handlers);
+          exproto->session_compression_handlers =
+            std::move(temp_compression_handlers);
           existing->write_lock.unlock();
           if (exproto->state == NONE) {
             existing->shutdown_socket();
@@ -4,6 +4,8 @@
 #ifndef _MSG_ASYNC_PROTOCOL_V2_
 #define _MSG_ASYNC_PROTOCOL_V2_
 
+#include <optional>
+
 #include <boost/container/static_vector.hpp>
 
 #include "Protocol.h"
@@ -19,6 +21,7 @@ private:
     HELLO_CONNECTING,
     AUTH_CONNECTING,
     AUTH_CONNECTING_SIGN,
+    COMPRESSION_CONNECTING,
     SESSION_CONNECTING,
     SESSION_RECONNECTING,
     START_ACCEPT,
@@ -27,6 +30,7 @@ private:
     AUTH_ACCEPTING,
     AUTH_ACCEPTING_MORE,
     AUTH_ACCEPTING_SIGN,
+    COMPRESSION_ACCEPTING,
     SESSION_ACCEPTING,
     READY,
     THROTTLE_MESSAGE,
@@ -46,6 +50,7 @@ private:
                                       "HELLO_CONNECTING",
                                       "AUTH_CONNECTING",
                                       "AUTH_CONNECTING_SIGN",
+                                      "COMPRESSION_CONNECTING",
                                       "SESSION_CONNECTING",
                                       "SESSION_RECONNECTING",
                                       "START_ACCEPT",
@@ -54,6 +59,7 @@ private:
                                       "AUTH_ACCEPTING",
                                       "AUTH_ACCEPTING_MORE",
                                       "AUTH_ACCEPTING_SIGN",
+                                      "COMPRESSION_ACCEPTING",
                                       "SESSION_ACCEPTING",
                                       "READY",
                                       "THROTTLE_MESSAGE",
@@ -70,9 +76,11 @@ private:
 public:
   // TODO: move into auth_meta?
   ceph::crypto::onwire::rxtx_t session_stream_handlers;
+  ceph::compression::onwire::rxtx_t session_compression_handlers;
 private:
   entity_name_t peer_name;
   State state;
+  uint64_t peer_supported_features;
   uint64_t peer_required_features;
 
   uint64_t client_cookie;
@@ -102,6 +110,10 @@ private:
   boost::container::static_vector<ceph::bufferlist,
 				  ceph::msgr::v2::MAX_NUM_SEGMENTS> rx_segments_data;
   ceph::msgr::v2::Tag next_tag;
+  __u8 next_preamble_flags;
+  // lengths after decompression, from the compression_header_t of a
+  // message frame with compressed segments
+  std::array<uint32_t, ceph::msgr::v2::MAX_NUM_SEGMENTS> rx_segments_raw_len;
   utime_t backoff;  // backoff time
   utime_t recv_stamp;
   utime_t throttle_stamp;
@@ -186,6 +198,13 @@ private:
 
   Ct<ProtocolV2> *handle_message_ack(ceph::bufferlist &payload);
 
+  bool handle_compression_header();
+  bool decompress_segments();
+  // data_off of the message being read, if segment idx is its data
+  // segment and is to be read straight into the layout data_off asks for
+  std::optional<uint32_t> get_rx_data_off(std::size_t idx);
+  static ceph::bufferptr alloc_data_segment(unsigned len, unsigned off);
+
 public:
   uint64_t connection_features;
 
@@ -220,6 +239,8 @@ private:
   Ct<ProtocolV2> *handle_auth_reply_more(ceph::bufferlist &payload);
   Ct<ProtocolV2> *handle_auth_done(ceph::bufferlist &payload);
   Ct<ProtocolV2> *handle_auth_signature(ceph::bufferlist &payload);
+  Ct<ProtocolV2> *send_compression_request();
+  Ct<ProtocolV2> *handle_compression_done(ceph::bufferlist &payload);
   Ct<ProtocolV2> *send_client_ident();
   Ct<ProtocolV2> *send_reconnect();
   Ct<ProtocolV2> *handle_ident_missing_features(ceph::bufferlist &payload);
@@ -241,6 +262,7 @@ private:
   Ct<ProtocolV2> *handle_auth_request_more(ceph::bufferlist &payload);
   Ct<ProtocolV2> *_handle_auth_request(ceph::bufferlist& auth_payload, bool more);
   Ct<ProtocolV2> *_auth_bad_method(int r);
+  Ct<ProtocolV2> *handle_compression_request(ceph::bufferlist &payload);
   Ct<ProtocolV2> *handle_client_ident(ceph::bufferlist &payload);
   Ct<ProtocolV2> *handle_ident_missing_features_write(int r);
   Ct<ProtocolV2> *handle_reconnect(ceph::bufferlist &payload);
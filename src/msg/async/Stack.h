@@ -29,6 +29,7 @@ class ConnectedSocketImpl {
   virtual int is_connected() = 0;
   virtual ssize_t read(char*, size_t) = 0;
   virtual ssize_t send(ceph::buffer::list &bl, bool more) = 0;
+  virtual void reap_send_completions() {}
   virtual void shutdown() = 0;
   virtual void close() = 0;
   virtual int fd() const = 0;
@@ -41,6 +42,7 @@ struct SocketOptions {
   int rcbuf_size = 0;
   int priority = -1;
   entity_addr_t connect_bind_addr;
+  unsigned zerocopy_min_size = 0;  ///< 0 disables MSG_ZEROCOPY sends
 };
 
 /// \cond internal
@@ -99,6 +101,10 @@ class ConnectedSocket {
   ssize_t send(ceph::buffer::list &bl, bool more) {
     return _csi->send(bl, more);
   }
+  /// Releases buffers of zero-copy sends the stack reports as complete.
+  void reap_send_completions() {
+    _csi->reap_send_completions();
+  }
   /// Disables output to the socket.
   ///
   /// Current or future writes that have not been successfully flushed
@@ -203,6 +209,20 @@ enum {
   l_msgr_send_messages_queue_lat,
   l_msgr_handle_ack_lat,
 
+  l_msgr_send_compressed_messages,
+  l_msgr_send_compressed_raw_bytes,
+  l_msgr_send_compressed_bytes,
+  l_msgr_compress_lat,
+  l_msgr_recv_compressed_messages,
+  l_msgr_decompress_lat,
+
+  l_msgr_recv_unaligned_data_bytes,
+
+  l_msgr_send_syscalls,
+  l_msgr_send_batch_messages,
+  l_msgr_send_batch_bytes,
+  l_msgr_send_deferred,
+
   l_msgr_last,
 };
 
@@ -234,7 +254,7 @@ class Worker {
     plb.add_u64_counter(l_msgr_recv_messages, "msgr_recv_messages", "Network received messages");
     plb.add_u64_counter(l_msgr_send_messages, "msgr_send_messages", "Network sent messages");
     plb.add_u64_counter(l_msgr_recv_bytes, "msgr_recv_bytes", "Network received bytes", NULL, 0, unit_t(UNIT_BYTES));
-    plb.add_u64_counter(l_msgr_send_bytes, "msgr_send_bytes", "Network sent bytes", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_bytes, "msgr_send_bytes", "Network sent bytes, including handshake, keepalive and ack frames", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_msgr_active_connections, "msgr_active_connections", "Active connection number");
     plb.add_u64_counter(l_msgr_created_connections, "msgr_created_connections", "Created connection number");
 
@@ -246,6 +266,20 @@ class Worker {
     plb.add_time_avg(l_msgr_send_messages_queue_lat, "msgr_send_messages_queue_lat", "Network sent messages lat");
     plb.add_time_avg(l_msgr_handle_ack_lat, "msgr_handle_ack_lat", "Connection handle ack lat");
 
+    plb.add_u64_counter(l_msgr_send_compressed_messages, "msgr_send_compressed_messages", "Network sent messages with compressed segments");
+    plb.add_u64_counter(l_msgr_send_compressed_raw_bytes, "msgr_send_compressed_raw_bytes", "Payload bytes of compressed messages before compression", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_compressed_bytes, "msgr_send_compressed_bytes", "Payload bytes of compressed messages after compression", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_time_avg(l_msgr_compress_lat, "msgr_compress_lat", "Time spent compressing outgoing messages");
+    plb.add_u64_counter(l_msgr_recv_compressed_messages, "msgr_recv_compressed_messages", "Network received messages with compressed segments");
+    plb.add_time_avg(l_msgr_decompress_lat, "msgr_decompress_lat", "Time spent decompressing incoming messages");
+
+    plb.add_u64_counter(l_msgr_recv_unaligned_data_bytes, "msgr_recv_unaligned_data_bytes", "Received data bytes not placed at the alignment requested by data_off", NULL, 0, unit_t(UNIT_BYTES));
+
+    plb.add_u64_counter(l_msgr_send_syscalls, "msgr_send_syscalls", "Socket sends issued");
+    plb.add_u64_avg(l_msgr_send_batch_messages, "msgr_send_batch_messages", "Messages written per socket send");
+    plb.add_u64_avg(l_msgr_send_batch_bytes, "msgr_send_batch_bytes", "Bytes written per socket send", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_deferred, "msgr_send_deferred", "Sends held back by ms_async_batch_window_us");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
   }
@@ -0,0 +1,117 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <algorithm>
+
+#include "compression_onwire.h"
+
+#include "common/debug.h"
+#include "include/str_list.h"
+#include "include/msgr.h"
+
+#define dout_subsys ceph_subsys_ms
+
+namespace ceph::compression::onwire {
+
+bool TxHandler::compress(ceph::bufferlist &segment)
+{
+  if (segment.length() == 0) {
+    return false;
+  }
+  ceph::bufferlist out;
+  if (compressor->compress(segment, out) != 0 ||
+      out.length() >= segment.length()) {
+    return false;
+  }
+  segment = std::move(out);
+  return true;
+}
+
+bool RxHandler::decompress(ceph::bufferlist &segment, std::uint32_t raw_len)
+{
+  ceph::bufferlist out;
+  if (compressor->decompress(segment, out) != 0 ||
+      out.length() != raw_len) {
+    return false;
+  }
+  segment = std::move(out);
+  return true;
+}
+
+rxtx_t rxtx_t::create_handler_pair(
+  CephContext *cct,
+  std::uint32_t method,
+  std::uint32_t min_size)
+{
+  if (method == Compressor::COMP_ALG_NONE) {
+    return { nullptr, nullptr };
+  }
+  // separate instances: the two directions may run in parallel with
+  // a stateful plugin
+  auto rx_comp = Compressor::create(cct, method);
+  auto tx_comp = Compressor::create(cct, method);
+  if (!rx_comp || !tx_comp) {
+    ldout(cct, 1) << __func__ << " unable to load compressor "
+		  << Compressor::get_comp_alg_name(method) << dendl;
+    return { nullptr, nullptr };
+  }
+  return {
+    std::make_unique<RxHandler>(std::move(rx_comp)),
+    std::make_unique<TxHandler>(std::move(tx_comp), min_size)
+  };
+}
+
+bool want_compression(CephContext *cct, int my_type, int peer_type,
+		      bool secure)
+{
+  if (secure && !cct->_conf.get_val<bool>("ms_compress_secure")) {
+    return false;
+  }
+  std::string mode;
+  if (my_type == CEPH_ENTITY_TYPE_OSD && peer_type == CEPH_ENTITY_TYPE_OSD) {
+    mode = cct->_conf.get_val<std::string>("ms_osd_compress_mode");
+  } else if (my_type == CEPH_ENTITY_TYPE_CLIENT ||
+	     peer_type == CEPH_ENTITY_TYPE_CLIENT) {
+    mode = cct->_conf.get_val<std::string>("ms_client_compress_mode");
+  } else {
+    return false;
+  }
+  auto m = Compressor::get_comp_mode_type(mode);
+  return m && *m != Compressor::COMP_NONE;
+}
+
+std::vector<std::uint32_t> get_preferred_methods(CephContext *cct)
+{
+  std::vector<std::uint32_t> methods;
+  for (const auto &name : get_str_list(
+	 cct->_conf.get_val<std::string>("ms_compression_algorithm"))) {
+    auto alg = Compressor::get_comp_alg_type(name);
+    if (!alg || *alg == Compressor::COMP_ALG_NONE) {
+      ldout(cct, 1) << __func__ << " ignoring unknown method " << name << dendl;
+      continue;
+    }
+    methods.push_back(*alg);
+  }
+  return methods;
+}
+
+std::uint32_t pick_method(CephContext *cct,
+			  const std::vector<std::uint32_t> &peer_methods)
+{
+  // our preference order wins; the method must also load locally
+  for (auto method : get_preferred_methods(cct)) {
+    if (std::find(peer_methods.begin(), peer_methods.end(), method) !=
+	  peer_methods.end() &&
+	Compressor::create(cct, method)) {
+      return method;
+    }
+  }
+  return Compressor::COMP_ALG_NONE;
+}
+
+std::uint32_t get_min_size(CephContext *cct)
+{
+  return cct->_conf.get_val<Option::size_t>("ms_compress_min_size");
+}
+
+} // namespace ceph::compression::onwire
@@ -0,0 +1,86 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_COMPRESSION_ONWIRE_H
+#define CEPH_COMPRESSION_ONWIRE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "compressor/Compressor.h"
+#include "include/buffer.h"
+
+namespace ceph::compression::onwire {
+
+// Compresses the segments of outgoing message frames. Segments are
+// compressed independently; a segment that doesn't shrink is left alone
+// and sent as-is.
+class TxHandler {
+  CompressorRef compressor;
+  std::uint32_t min_size;
+
+public:
+  TxHandler(CompressorRef compressor, std::uint32_t min_size)
+    : compressor(std::move(compressor)), min_size(min_size) {
+  }
+
+  // frames whose payload is below this size are not worth compressing
+  std::uint32_t get_min_size() const {
+    return min_size;
+  }
+
+  // Compress the segment in place. Returns false, leaving the segment
+  // untouched, if compression fails or doesn't reduce its size.
+  bool compress(ceph::bufferlist &segment);
+};
+
+class RxHandler {
+  CompressorRef compressor;
+
+public:
+  explicit RxHandler(CompressorRef compressor)
+    : compressor(std::move(compressor)) {
+  }
+
+  // Decompress the segment in place. Returns false on corrupt input,
+  // or if it doesn't decompress to exactly raw_len bytes.
+  bool decompress(ceph::bufferlist &segment, std::uint32_t raw_len);
+};
+
+struct rxtx_t {
+  std::unique_ptr<RxHandler> rx;
+  std::unique_ptr<TxHandler> tx;
+
+  // method is a Compressor::CompressionAlgorithm; COMP_ALG_NONE (or a
+  // method we can't instantiate) yields an empty pair
+  static rxtx_t create_handler_pair(
+    CephContext *cct,
+    std::uint32_t method,
+    std::uint32_t min_size);
+};
+
+// Connection policy, derived from the ms_*_compress_* options.
+//
+// A session is compressed only if both ends want it: the connecting side
+// advertises its preferred methods in SEGMENT_COMPRESSION_REQUEST and the
+// accepting side picks one (or none) in SEGMENT_COMPRESSION_DONE.
+bool want_compression(CephContext *cct, int my_type, int peer_type,
+		      bool secure);
+std::vector<std::uint32_t> get_preferred_methods(CephContext *cct);
+std::uint32_t pick_method(CephContext *cct,
+			  const std::vector<std::uint32_t> &peer_methods);
+std::uint32_t get_min_size(CephContext *cct);
+
+} // namespace ceph::compression::onwire
+
+#endif // CEPH_COMPRESSION_ONWIRE_H
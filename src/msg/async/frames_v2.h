@@ -4,6 +4,7 @@
 #include "include/types.h"
 #include "common/Clock.h"
 #include "crypto_onwire.h"
+#include "compression_onwire.h"
 #include <array>
 #include <utility>
 
@@ -52,7 +53,11 @@ enum class Tag : __u8 {
   MESSAGE,
   KEEPALIVE2,
   KEEPALIVE2_ACK,
-  ACK
+  ACK,
+  // not upstream's COMPRESSION_REQUEST/DONE (20, 21): the wire format
+  // differs, so these live apart from the sequentially allocated tags
+  SEGMENT_COMPRESSION_REQUEST = 0x40,
+  SEGMENT_COMPRESSION_DONE
 };
 
 struct segment_t {
@@ -99,7 +104,11 @@ struct preamble_block_t {
   __u8 num_segments;
 
   segment_t segments[MAX_NUM_SEGMENTS];
-  __u8 _reserved[2];
+
+  // FRAME_EARLY_* flags. Only set once the peers negotiated a feature
+  // that gives them meaning; older peers ignore this byte.
+  __u8 flags;
+  __u8 _reserved;
 
   // CRC32 for this single preamble block.
   ceph_le32 crc;
@@ -150,6 +159,20 @@ static constexpr uint32_t FRAME_SECURE_EPILOGUE_SIZE =
 
 #define FRAME_FLAGS_LATEABRT      (1<<0)   /* frame was aborted after txing data */
 
+/* preamble flags: segment idx was compressed with the session's method */
+#define FRAME_EARLY_SEGMENT_COMPRESSED(idx) (1 << (idx))
+#define FRAME_EARLY_COMPRESSED_MASK \
+  ((1 << ceph::msgr::v2::MAX_NUM_SEGMENTS) - 1)
+
+// Trails the message header in the header segment of a message frame
+// with compressed segments. It declares each segment's length after
+// decompression so that the receiver can throttle on those before
+// reading the rest of the frame, and bound the decompressor's output.
+struct compression_header_t {
+  ceph_le32 raw_lengths[MAX_NUM_SEGMENTS];
+} __attribute__((packed));
+static_assert(std::is_standard_layout<compression_header_t>::value);
+
 static uint32_t segment_onwire_size(const uint32_t logical_size)
 {
   return p2roundup<uint32_t>(logical_size, CRYPTO_BLOCK_SIZE);
@@ -170,6 +193,7 @@ struct Frame {
   static_assert(SegmentsNumV > 0 && SegmentsNumV <= MAX_NUM_SEGMENTS);
 protected:
   std::array<ceph::bufferlist, SegmentsNumV> segments;
+  __u8 preamble_flags = 0;
 
 private:
   static constexpr std::array<uint16_t, SegmentsNumV> alignments {
@@ -218,6 +242,7 @@ private:
     // calculate the number of non-empty segments.
     // TODO: reorder segments to get DATA first
     main_preamble.num_segments = calc_num_segments(main_preamble.segments);
+    main_preamble.flags = preamble_flags;
 
     main_preamble.crc =
         ceph_crc32c(0, reinterpret_cast<unsigned char *>(&main_preamble),
@@ -253,11 +278,11 @@ public:
       reset_tx_handler(
           session_stream_handlers, std::make_index_sequence<SegmentsNumV>());
 
+      // hand all segments and the epilogue over in one go so the cipher
+      // can batch the small pieces (preamble, header, padding, epilogue)
+      ceph::bufferlist plaintext;
       for (auto& segment : segments) {
-        if (segment.length()) {
-          session_stream_handlers.tx->authenticated_encrypt_update(
-            std::move(segment));
-        }
+        plaintext.append(segment);
       }
 
       // in secure mode we craft only the late_flags. Signature (for AES-GCM
@@ -267,11 +292,10 @@ public:
         // FIPS zeroization audit 20191115: this memset is not security
         // related.
         ::memset(&epilogue, 0, sizeof(epilogue));
-        ceph::bufferlist epilogue_bl;
-        epilogue_bl.append(reinterpret_cast<const char*>(&epilogue),
-                           sizeof(epilogue));
-        session_stream_handlers.tx->authenticated_encrypt_update(epilogue_bl);
+        plaintext.append(reinterpret_cast<const char*>(&epilogue),
+                         sizeof(epilogue));
       }
+      session_stream_handlers.tx->authenticated_encrypt_update(plaintext);
       return session_stream_handlers.tx->authenticated_encrypt_final();
     } else {
       // plain mode
@@ -662,6 +686,36 @@ protected:
   using ControlFrame::ControlFrame;
 };
 
+struct CompressionRequestFrame
+    : public ControlFrame<CompressionRequestFrame,
+                          bool, // is compress
+                          std::vector<uint32_t>> { // preferred methods
+  static const Tag tag = Tag::SEGMENT_COMPRESSION_REQUEST;
+  using ControlFrame::Encode;
+  using ControlFrame::Decode;
+
+  inline bool &is_compress() { return get_val<0>(); }
+  inline std::vector<uint32_t> &preferred_methods() { return get_val<1>(); }
+
+protected:
+  using ControlFrame::ControlFrame;
+};
+
+struct CompressionDoneFrame
+    : public ControlFrame<CompressionDoneFrame,
+                          bool, // is compress
+                          uint32_t> { // method
+  static const Tag tag = Tag::SEGMENT_COMPRESSION_DONE;
+  using ControlFrame::Encode;
+  using ControlFrame::Decode;
+
+  inline bool &is_compress() { return get_val<0>(); }
+  inline uint32_t &method() { return get_val<1>(); }
+
+protected:
+  using ControlFrame::ControlFrame;
+};
+
 struct AckFrame : public ControlFrame<AckFrame,
                                       uint64_t> { // message sequence
   static const Tag tag = Tag::ACK;
@@ -748,6 +802,28 @@ struct MessageFrame : public Frame<MessageFrame,
     return segments[SegmentIndex::Msg::DATA].length();
   }
 
+  // Compress front, middle and data in place; the header stays plain
+  // but gains a compression_header_t. Returns true if any segment was
+  // compressed.
+  bool compress(ceph::compression::onwire::TxHandler &tx) {
+    compression_header_t ch;
+    ch.raw_lengths[SegmentIndex::Msg::HEADER] = 0;
+    for (auto idx : { SegmentIndex::Msg::FRONT,
+                      SegmentIndex::Msg::MIDDLE,
+                      SegmentIndex::Msg::DATA }) {
+      ch.raw_lengths[idx] = segments[idx].length();
+      if (tx.compress(segments[idx])) {
+        preamble_flags |= FRAME_EARLY_SEGMENT_COMPRESSED(idx);
+      }
+    }
+    if (!(preamble_flags & FRAME_EARLY_COMPRESSED_MASK)) {
+      return false;
+    }
+    segments[SegmentIndex::Msg::HEADER].append(
+      reinterpret_cast<const char*>(&ch), sizeof(ch));
+    return true;
+  }
+
 protected:
   using Frame::Frame;
 };
@@ -469,6 +469,32 @@ public:
      ceph::buffer::list& bl,
      uint32_t op_flags = 0) = 0;
 
+  /**
+   * verify_data -- check a byte range of an object against the
+   * checksums the store keeps for it, without returning the data
+   *
+   * Stores that don't checksum data, or don't have checksums for all
+   * of the range, return -EOPNOTSUPP and the caller has to read() and
+   * check the data itself.
+   *
+   * @param cid collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte to be verified
+   * @param len number of bytes to be verified
+   * @param op_flags is CEPH_OSD_OP_FLAG_*
+   * @returns number of bytes verified on success (as read() would have
+   *          returned), -EIO if the data doesn't match its checksums, or
+   *          another negative error code on failure.
+   */
+   virtual int verify_data(
+     CollectionHandle &c,
+     const ghobject_t& oid,
+     uint64_t offset,
+     size_t len,
+     uint32_t op_flags = 0) {
+     return -EOPNOTSUPP;
+   }
+
   /**
    * fiemap -- get extent std::map of data of an object
    *
@@ -172,6 +172,22 @@ BlueFS::~BlueFS()
 
 void BlueFS::_init_logger()
 {
+  // values are in nanoseconds
+  PerfHistogramCommon::axis_config_d lock_hist_x_axis_config{
+    "Lock hold time (usec)",
+    PerfHistogramCommon::SCALE_LOG2, ///< Latency in logarithmic scale
+    0,                               ///< Start at 0
+    10000,                           ///< Quantization unit is 10usec
+    24,                              ///< Enough to cover minutes
+  };
+  PerfHistogramCommon::axis_config_d lock_hist_y_axis_config{
+    "Number of files",
+    PerfHistogramCommon::SCALE_LOG2, ///< File count in logarithmic scale
+    0,                               ///< Start at 0
+    64,                              ///< Quantization unit is 64 files
+    16,                              ///< Enough to cover millions of files
+  };
+
   PerfCountersBuilder b(cct, "bluefs",
                         l_bluefs_first, l_bluefs_last);
   b.add_u64_counter(l_bluefs_gift_bytes, "gift_bytes",
@@ -202,6 +218,12 @@ void BlueFS::_init_logger()
 	    "jlen", PerfCountersBuilder::PRIO_INTERESTING, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluefs_log_compactions, "log_compactions",
 		    "Compactions of the metadata log");
+  b.add_time_avg(l_bluefs_log_compaction_lock_lat, "log_compaction_lock_lat",
+		 "Time the metadata log compaction holds the BlueFS lock");
+  b.add_u64_counter_histogram(
+    l_bluefs_log_compaction_lock_hist, "log_compaction_lock_lat_histogram",
+    lock_hist_x_axis_config, lock_hist_y_axis_config,
+    "Histogram of log compaction lock hold time + number of files");
   b.add_u64_counter(l_bluefs_logged_bytes, "logged_bytes",
 		    "Bytes written to the metadata log", "j",
 		    PerfCountersBuilder::PRIO_CRITICAL, unit_t(UNIT_BYTES));
@@ -249,6 +271,13 @@ void BlueFS::_init_logger()
 
   b.add_u64_counter(l_bluefs_read_prefetch_count, "read_prefetch_count",
 		    "prefetch read requests processed");
+  b.add_u64_counter(l_bluefs_read_random_readahead_count,
+		    "read_random_readahead_count",
+		    "Readaheads issued for sequential random reads");
+  b.add_u64_counter(l_bluefs_read_random_readahead_bytes,
+		    "read_random_readahead_bytes",
+		    "Bytes read ahead for sequential random reads", NULL,
+		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluefs_read_prefetch_bytes, "read_prefetch_bytes",
 		    "Bytes requested in prefetch read mode", NULL,
 		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
@@ -1917,10 +1946,19 @@ int64_t BlueFS::_read_random(
   logger->inc(l_bluefs_read_random_count, 1);
   logger->inc(l_bluefs_read_random_bytes, len);
 
+  bool readahead = _want_random_readahead(h, off, len);
   std::shared_lock s_lock(h->lock);
   while (len > 0) {
     if (off < buf->bl_off || off >= buf->get_buf_end()) {
       s_lock.unlock();
+      if (readahead) {
+	readahead = false;
+	if (_fill_random_readahead(h, off, len)) {
+	  s_lock.lock();
+	  // serve from the buffer if nobody replaced it in the meantime
+	  continue;
+	}
+      }
       uint64_t x_off = 0;
       auto p = h->file->fnode.seek(off, &x_off);
       uint64_t l = std::min(p->length - x_off, len);
@@ -1973,6 +2011,81 @@ int64_t BlueFS::_read_random(
   return ret;
 }
 
+// RocksDB reads SSTs through random access files even when an iterator
+// walks them front to back.  Detect runs of reads that continue each
+// other; once a run is established, buffer misses read ahead.
+bool BlueFS::_want_random_readahead(FileReader *h, uint64_t off,
+				    uint64_t len)
+{
+  auto* buf = &h->buf;
+  if (off != buf->last_read_end.exchange(off + len)) {
+    if (buf->seq_reads.exchange(0) >= 2) {
+      // the run is over, do not keep its window around
+      std::unique_lock u_lock(h->lock);
+      buf->bl.clear();
+      buf->bl_off = 0;
+      buf->readahead = 0;
+      buf->release_readahead();
+    }
+    return false;
+  }
+  return ++buf->seq_reads >= 2 &&
+    len > 0 &&
+    cct->_conf->bluefs_readahead_min > 0 &&
+    len < cct->_conf->bluefs_max_prefetch;
+}
+
+// Refill the reader buffer from @off.  The window starts at
+// bluefs_readahead_min and doubles with every refill of the same run.
+// Windows of all readers together are capped at bluefs_readahead_max_total,
+// since a reader keeps its window until the run is broken by another read
+// or the reader is closed.  Returns false if there was no room for it.
+bool BlueFS::_fill_random_readahead(FileReader *h, uint64_t off, uint64_t len)
+{
+  auto* buf = &h->buf;
+  std::unique_lock u_lock(h->lock);
+  if (off >= buf->bl_off && off < buf->get_buf_end()) {
+    return true;  // raced with another reader
+  }
+  if (buf->seq_reads == 2 || !buf->readahead) {
+    buf->readahead = cct->_conf->bluefs_readahead_min;
+  } else {
+    buf->readahead = std::min<uint64_t>(buf->readahead * 2,
+					cct->_conf->bluefs_max_prefetch);
+  }
+  buf->bl.clear();
+  buf->release_readahead();
+  buf->bl_off = off & super.block_mask();
+  uint64_t x_off = 0;
+  auto p = h->file->fnode.seek(buf->bl_off, &x_off);
+  uint64_t l = round_up_to(std::max(len, buf->readahead) +
+			   (off & ~super.block_mask()),
+			   super.block_size);
+  l = std::min(p->length - x_off, l);
+  uint64_t eof_offset = round_up_to(h->file->fnode.size, super.block_size);
+  if (buf->bl_off + l > eof_offset) {
+    l = eof_offset - buf->bl_off;
+  }
+  if (readahead_total + l > cct->_conf->bluefs_readahead_max_total) {
+    dout(20) << __func__ << " h " << h << " no room for 0x" << std::hex
+	     << l << " readahead, 0x" << readahead_total
+	     << " held" << std::dec << dendl;
+    buf->bl_off = 0;
+    buf->readahead = 0;
+    return false;
+  }
+  dout(20) << __func__ << " h " << h << " reading ahead 0x"
+	   << std::hex << x_off << "~" << l << std::dec
+	   << " of " << *p << dendl;
+  int r = bdev[p->bdev]->read(p->offset + x_off, l, &buf->bl, ioc[p->bdev],
+			      cct->_conf->bluefs_buffered_io);
+  ceph_assert(r == 0);
+  buf->hold_readahead(&readahead_total);
+  logger->inc(l_bluefs_read_random_readahead_count);
+  logger->inc(l_bluefs_read_random_readahead_bytes, l);
+  return true;
+}
+
 int64_t BlueFS::_read(
   FileReader *h,         ///< [in] read from here
   uint64_t off,          ///< [in] offset
@@ -2020,6 +2133,7 @@ int64_t BlueFS::_read(
       if (off < buf->bl_off || off >= buf->get_buf_end()) {
         // if precondition hasn't changed during locking upgrade.
         buf->bl.clear();
+        buf->release_readahead();
         buf->bl_off = off & super.block_mask();
         uint64_t x_off = 0;
         auto p = h->file->fnode.seek(buf->bl_off, &x_off);
@@ -2223,9 +2337,18 @@ void BlueFS::_compact_log_dump_metadata(bluefs_transaction_t *t,
   }
 }
 
+void BlueFS::_note_compaction_lock_held(ceph::mono_clock::time_point since)
+{
+  auto held = ceph::mono_clock::now() - since;
+  logger->tinc(l_bluefs_log_compaction_lock_lat, held);
+  logger->hinc(l_bluefs_log_compaction_lock_hist,
+	       std::chrono::nanoseconds(held).count(), file_map.size());
+}
+
 void BlueFS::_compact_log_sync()
 {
   dout(10) << __func__ << dendl;
+  auto start = ceph::mono_clock::now();
   auto prefer_bdev =
     vselector->select_prefer_bdev(log_writer->file->vselector_hint);
   _rewrite_log_and_layout_sync(true,
@@ -2235,6 +2358,7 @@ void BlueFS::_compact_log_sync()
     0,
     super.memorized_layout);
   logger->inc(l_bluefs_log_compactions);
+  _note_compaction_lock_held(start);
 }
 
 void BlueFS::_rewrite_log_and_layout_sync(bool allocate_with_fallback,
@@ -2332,9 +2456,10 @@ void BlueFS::_rewrite_log_and_layout_sync(bool allocate_with_fallback,
  * old extent(s) won't be written to, and reflect everything to compact.
  * New events will be written to the new region that we'll keep.
  *
- * 2. While still holding the lock, encode a bufferlist that dumps all of the
- * in-memory fnodes and names.  This will become the new beginning of the
+ * 2. While still holding the lock, dump all of the in-memory fnodes and
+ * names into a transaction.  This will become the new beginning of the
  * log.  The last event will jump to the log continuation extent from #1.
+ * The transaction is encoded with the lock dropped.
  *
  * 3. Queue a write to a new extent for the new beginnging of the log.
  *
@@ -2392,6 +2517,7 @@ void BlueFS::_compact_log_async(std::unique_lock<ceph::mutex>& l)
   _flush_and_sync_log(l, 0, old_log_jump_to);
 
   // 2. prepare compacted log
+  auto held_since = ceph::mono_clock::now();
   bluefs_transaction_t t;
   //avoid record two times in log_t and _compact_log_dump_metadata.
   log_t.clear();
@@ -2415,14 +2541,22 @@ void BlueFS::_compact_log_async(std::unique_lock<ceph::mutex>& l)
   // we might have some more ops in log_t due to _allocate call
   t.claim_ops(log_t);
 
-  bufferlist bl;
-  encode(t, bl);
-  _pad_bl(bl);
-
   dout(10) << __func__ << " new_log_jump_to 0x" << std::hex << new_log_jump_to
 	   << std::dec << dendl;
 
+  // (new_log_writer also holds off log runway allocations until we are done)
   new_log_writer = _create_writer(new_log);
+
+  // t is private to us now; encoding and checksumming it can be
+  // expensive with many files, so do not block other BlueFS users
+  _note_compaction_lock_held(held_since);
+  l.unlock();
+  bufferlist bl;
+  encode(t, bl);
+  _pad_bl(bl);
+  l.lock();
+  held_since = ceph::mono_clock::now();
+
   new_log_writer->append(bl);
 
   // 3. flush
@@ -2430,7 +2564,9 @@ void BlueFS::_compact_log_async(std::unique_lock<ceph::mutex>& l)
   ceph_assert(r == 0);
 
   // 4. wait
+  _note_compaction_lock_held(held_since);
   _flush_bdev_safely(new_log_writer);
+  held_since = ceph::mono_clock::now();
 
   // 5. update our log fnode
   // discard first old_log_jump_to extents
@@ -2483,6 +2619,7 @@ void BlueFS::_compact_log_async(std::unique_lock<ceph::mutex>& l)
   ++super.version;
   _write_super(BDEV_DB);
 
+  _note_compaction_lock_held(held_since);
   lock.unlock();
   flush_bdev();
   lock.lock();
@@ -32,6 +32,8 @@ enum {
   l_bluefs_num_files,
   l_bluefs_log_bytes,
   l_bluefs_log_compactions,
+  l_bluefs_log_compaction_lock_lat,
+  l_bluefs_log_compaction_lock_hist,
   l_bluefs_logged_bytes,
   l_bluefs_files_written_wal,
   l_bluefs_files_written_sst,
@@ -51,6 +53,8 @@ enum {
   l_bluefs_read_bytes,
   l_bluefs_read_prefetch_count,
   l_bluefs_read_prefetch_bytes,
+  l_bluefs_read_random_readahead_count,
+  l_bluefs_read_random_readahead_bytes,
 
   l_bluefs_last,
 };
@@ -221,8 +225,31 @@ public:
     uint64_t pos = 0;       ///< current logical offset
     uint64_t max_prefetch;  ///< max allowed prefetch
 
+    // sequential pattern detection for random reads
+    std::atomic<uint64_t> last_read_end = {0}; ///< end of last random read
+    std::atomic<unsigned> seq_reads = {0};     ///< reads continuing the last
+    uint64_t readahead = 0;                    ///< current readahead window
+    /// readahead bytes held by all readers, and our share of it
+    std::atomic<uint64_t> *readahead_total = nullptr;
+    uint64_t readahead_held = 0;
+
     explicit FileReaderBuffer(uint64_t mpf)
       : max_prefetch(mpf) {}
+    ~FileReaderBuffer() {
+      release_readahead();
+    }
+
+    void hold_readahead(std::atomic<uint64_t> *total) {
+      readahead_total = total;
+      readahead_held = bl.length();
+      *readahead_total += readahead_held;
+    }
+    void release_readahead() {
+      if (readahead_held) {
+	*readahead_total -= readahead_held;
+	readahead_held = 0;
+      }
+    }
 
     uint64_t get_buf_end() const {
       return bl_off + bl.length();
@@ -243,6 +270,7 @@ public:
       if (offset >= bl_off && offset < get_buf_end()) {
 	bl.clear();
 	bl_off = 0;
+	release_readahead();
       }
     }
   };
@@ -283,6 +311,8 @@ private:
   ceph::mutex lock = ceph::make_mutex("BlueFS::lock");
 
   PerfCounters *logger = nullptr;
+  /// random-read readahead held by all readers, see bluefs_readahead_max_total
+  std::atomic<uint64_t> readahead_total = {0};
 
   uint64_t max_bytes[MAX_BDEV] = {0};
   uint64_t max_bytes_pcounters[MAX_BDEV] = {
@@ -344,6 +374,9 @@ private:
 
   void _pad_bl(ceph::buffer::list& bl);  ///< pad ceph::buffer::list to block size w/ zeros
 
+  bool _want_random_readahead(FileReader *h, uint64_t off, uint64_t len);
+  bool _fill_random_readahead(FileReader *h, uint64_t off, uint64_t len);
+
   FileRef _get_file(uint64_t ino);
   void _drop_link(FileRef f);
 
@@ -381,6 +414,7 @@ private:
   void _compact_log_dump_metadata(bluefs_transaction_t *t,
 				  int flags);
   void _compact_log_sync();
+  void _note_compaction_lock_held(ceph::mono_clock::time_point since);
   void _compact_log_async(std::unique_lock<ceph::mutex>& l);
 
   void _rewrite_log_and_layout_sync(bool allocate_with_fallback,
@@ -810,6 +810,10 @@ int64_t BlueStore::GarbageCollector::estimate(
 }
 
 // LruOnodeCacheShard
+//
+// Onodes that are in use (nref > 1) or were looked up since the last
+// trim stay on the lru and are given a second chance at its head when
+// trim reaches them, rather than being moved around on every access.
 struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
   typedef boost::intrusive::list<
     BlueStore::Onode,
@@ -817,15 +821,8 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
       BlueStore::Onode,
       boost::intrusive::list_member_hook<>,
       &BlueStore::Onode::lru_item> > list_t;
-  typedef boost::intrusive::list<
-    BlueStore::Onode,
-    boost::intrusive::member_hook<
-      BlueStore::Onode,
-      boost::intrusive::list_member_hook<>,
-      &BlueStore::Onode::pin_item> > pin_list_t;
 
   list_t lru;
-  pin_list_t pin_list;
 
   explicit LruOnodeCacheShard(CephContext *cct) : BlueStore::OnodeCacheShard(cct) {}
 
@@ -833,60 +830,19 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
   {
     ceph_assert(o->s == nullptr);
     o->s = this;
-    if (o->nref > 1) {
-      pin_list.push_front(*o);
-      o->pinned = true;
-      num_pinned = pin_list.size();
-    } else {
-      (level > 0) ? lru.push_front(*o) : lru.push_back(*o);
-    }
+    (level > 0) ? lru.push_front(*o) : lru.push_back(*o);
     num = lru.size();
   }
   void _rm(BlueStore::OnodeRef& o) override
   {
     o->s = nullptr;
-    if (o->pinned) {
-      o->pinned = false;
-      pin_list.erase(pin_list.iterator_to(*o));
-    } else {
-      lru.erase(lru.iterator_to(*o));
-    }
+    lru.erase(lru.iterator_to(*o));
     num = lru.size();
-    num_pinned = pin_list.size();
   }
   void _touch(BlueStore::OnodeRef& o) override
   {
-    if (o->pinned) {
-      return;
-    }
     lru.erase(lru.iterator_to(*o));
     lru.push_front(*o);
-    num = lru.size();
-  }
-  void _pin(BlueStore::Onode& o) override
-  {
-    if (o.pinned == true) {
-      return;
-    }
-    lru.erase(lru.iterator_to(o));
-    pin_list.push_front(o);
-    o.pinned = true;
-    num = lru.size();
-    num_pinned = pin_list.size();
-    dout(30) << __func__ << " " << o.oid << " pinned" << dendl;
-
-  } 
-  void _unpin(BlueStore::Onode& o) override
-  {
-    if (o.pinned == false) {
-      return;
-    }
-    pin_list.erase(pin_list.iterator_to(o));
-    lru.push_front(o);
-    o.pinned = false;
-    num = lru.size();
-    num_pinned = pin_list.size();
-    dout(30) << __func__ << " " << o.oid << " unpinned" << dendl;
   }
   void _trim_to(uint64_t new_size) override
   {
@@ -894,18 +850,25 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
       return; // don't even try
     } 
     uint64_t n = lru.size() - new_size;
-    auto p = lru.end();
-    ceph_assert(p != lru.begin());
-    --p;
-    while (n > 0) {
-      BlueStore::Onode *o = &*p;
-      dout(30) << __func__ << "  rm " << o->oid << dendl;
-      if (p != lru.begin()) {
-        lru.erase(p--);
-      } else {
-        lru.erase(p);
-        ceph_assert(n == 1);
+    // visit each onode at most once so that a cache full of onodes
+    // in use does not spin
+    uint64_t left = lru.size();
+    uint64_t in_use = 0;
+    while (n > 0 && left > 0) {
+      --left;
+      BlueStore::Onode *o = &lru.back();
+      // nref can only go from 1 to 2 through the OnodeSpace, which
+      // requires our lock, so an onode seen with nref == 1 here is
+      // referenced by its OnodeSpace only.
+      bool referenced = o->referenced.exchange(false);
+      if (o->nref > 1 || referenced) {
+	in_use += o->nref > 1;
+	lru.pop_back();
+	lru.push_front(*o);
+	continue;
       }
+      dout(30) << __func__ << "  rm " << o->oid << dendl;
+      lru.pop_back();
       o->s = nullptr;
       o->get();  // paranoia
       o->c->onode_map.remove(o->oid);
@@ -913,10 +876,11 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
       --n;
     }
     num = lru.size();
+    num_pinned = in_use;
   }
   void add_stats(uint64_t *onodes, uint64_t *pinned_onodes) override
   {
-    *onodes += num + num_pinned;
+    *onodes += num;
     *pinned_onodes += num_pinned;
   }
 };
@@ -1642,7 +1606,7 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
     } else {
       ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << p->second
 			    << dendl;
-      cache->_touch(p->second);
+      p->second->referenced = true;
       hit = true;
       o = p->second;
     }
@@ -2822,6 +2786,10 @@ unsigned BlueStore::ExtentMap::decode_some(bufferlist& bl)
   uint64_t pos = 0;
   uint64_t prev_len = 0;
   unsigned n = 0;
+  // extents are encoded in logical order and a shard covers a contiguous
+  // range, so each one goes right after the previous one; insert with a
+  // hint instead of searching the tree for every extent
+  extent_map_t::iterator hint;
 
   while (!p.end()) {
     Extent *le = new Extent();
@@ -2867,8 +2835,13 @@ unsigned BlueStore::ExtentMap::decode_some(bufferlist& bl)
 	le->length);
     }
     pos += prev_len;
+    if (n == 0) {
+      hint = extent_map.insert(*le).first;
+    } else {
+      hint = extent_map.insert(hint, *le);
+    }
+    ++hint;
     ++n;
-    extent_map.insert(*le);
   }
 
   ceph_assert(n == num);
@@ -3701,10 +3674,9 @@ void BlueStore::Collection::split_cache(
 			    << dendl;
 
       // move the onode to the new map before futzing with the cache
-      // shard, ensuring that nref is always >= 2, and no racing
-      // thread can trigger a pin or unpin (which does *not* behave
-      // well when we are clearing and resetting the 's' shard
-      // pointer!).
+      // shard, ensuring that nref is always >= 2 so that neither
+      // shard's trim can pick it while the 's' shard pointer is
+      // being cleared and reset.
       p = onode_map.onode_map.erase(p);
       dest->onode_map.onode_map[o->oid] = o;
 
@@ -4148,6 +4120,7 @@ BlueStore::BlueStore(CephContext *cct,
     finisher(cct, "commit_finisher", "cfin"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
+    defrag_thread(this),
     min_alloc_size(_min_alloc_size),
     min_alloc_size_order(ctz(_min_alloc_size)),
     mempool_thread(this)
@@ -4196,6 +4169,8 @@ const char **BlueStore::get_tracked_conf_keys() const
     "bluestore_deferred_batch_ops",
     "bluestore_deferred_batch_ops_hdd",
     "bluestore_deferred_batch_ops_ssd",
+    "bluestore_deferred_batch_ops_max",
+    "bluestore_deferred_batch_target_latency",
     "bluestore_throttle_bytes",
     "bluestore_throttle_deferred_bytes",
     "bluestore_throttle_cost_per_io_hdd",
@@ -4254,7 +4229,9 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
       changed.count("bluestore_max_alloc_size") ||
       changed.count("bluestore_deferred_batch_ops") ||
       changed.count("bluestore_deferred_batch_ops_hdd") ||
-      changed.count("bluestore_deferred_batch_ops_ssd")) {
+      changed.count("bluestore_deferred_batch_ops_ssd") ||
+      changed.count("bluestore_deferred_batch_ops_max") ||
+      changed.count("bluestore_deferred_batch_target_latency")) {
     if (bdev) {
       // only after startup
       _set_alloc_sizes();
@@ -4564,6 +4541,10 @@ void BlueStore::_init_logger()
 		    "Sum for deferred write op");
   b.add_u64_counter(l_bluestore_deferred_write_bytes, "deferred_write_bytes",
 		    "Sum for deferred write bytes", "def", 0, unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_deferred_batch_ops, "deferred_batch_ops",
+	    "Number of deferred writes queued before the queue is flushed");
+  b.add_time_avg(l_bluestore_deferred_batch_lat, "deferred_batch_lat",
+		 "Average deferred batch write latency");
   b.add_u64_counter(l_bluestore_write_penalty_read_ops, "write_penalty_read_ops",
 		    "Sum for write penalty read ops");
   b.add_u64(l_bluestore_allocated, "bluestore_allocated",
@@ -4582,7 +4563,7 @@ void BlueStore::_init_logger()
   b.add_u64(l_bluestore_onodes, "bluestore_onodes",
 	    "Number of onodes in cache");
   b.add_u64(l_bluestore_pinned_onodes, "bluestore_pinned_onodes",
-            "Number of pinned onodes in cache");
+            "Number of onodes in use found by the last cache trim");
   b.add_u64_counter(l_bluestore_onode_hits, "bluestore_onode_hits",
 		    "Sum for onode-lookups hit in the cache");
   b.add_u64_counter(l_bluestore_onode_misses, "bluestore_onode_misses",
@@ -4647,6 +4628,19 @@ void BlueStore::_init_logger()
                     "Read operations that required at least one retry due to failed checksum validation");
   b.add_u64(l_bluestore_fragmentation, "bluestore_fragmentation_micros",
             "How fragmented bluestore free space is (free extents / max possible number of free extents) * 1000");
+  b.add_u64(l_bluestore_defrag_queued, "bluestore_defrag_queued",
+	    "Objects waiting to be defragmented");
+  b.add_u64_counter(l_bluestore_defrag_objects, "bluestore_defrag_objects",
+		    "Objects rewritten by defragmentation");
+  b.add_u64_counter(l_bluestore_defrag_bytes, "bluestore_defrag_bytes",
+		    "Bytes rewritten by defragmentation", NULL, 0,
+		    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_defrag_extents_before,
+		    "bluestore_defrag_extents_before",
+		    "Physical extents of defragmented objects before rewrite");
+  b.add_u64_counter(l_bluestore_defrag_extents_after,
+		    "bluestore_defrag_extents_after",
+		    "Physical extents of defragmented objects after rewrite");
   b.add_time_avg(l_bluestore_omap_seek_to_first_lat, "omap_seek_to_first_lat",
     "Average omap iterator seek_to_first call latency");
   b.add_time_avg(l_bluestore_omap_upper_bound_lat, "omap_upper_bound_lat",
@@ -4845,6 +4839,15 @@ void BlueStore::_set_alloc_sizes(void)
       deferred_batch_ops = cct->_conf->bluestore_deferred_batch_ops_ssd;
     }
   }
+  deferred_batch_ops_min = deferred_batch_ops.load();
+  deferred_batch_ops_max = std::max<int>(
+    deferred_batch_ops_min,
+    cct->_conf.get_val<uint64_t>("bluestore_deferred_batch_ops_max"));
+  deferred_batch_target_lat =
+    cct->_conf.get_val<double>("bluestore_deferred_batch_target_latency");
+  if (logger) {
+    logger->set(l_bluestore_deferred_batch_ops, deferred_batch_ops);
+  }
 
   dout(10) << __func__ << " min_alloc_size 0x" << std::hex << min_alloc_size
 	   << std::dec << " order " << (int)min_alloc_size_order
@@ -4852,6 +4855,8 @@ void BlueStore::_set_alloc_sizes(void)
 	   << " prefer_deferred_size 0x" << prefer_deferred_size
 	   << std::dec
 	   << " deferred_batch_ops " << deferred_batch_ops
+	   << " (max " << deferred_batch_ops_max
+	   << " target lat " << deferred_batch_target_lat << ")"
 	   << dendl;
 }
 
@@ -5082,15 +5087,19 @@ int BlueStore::_open_alloc()
   uint64_t num = 0, bytes = 0;
 
   dout(1) << __func__ << " opening allocation metadata" << dendl;
-  // initialize from freelist
-  fm->enumerate_reset();
-  uint64_t offset, length;
-  while (fm->enumerate_next(db, &offset, &length)) {
-    alloc->init_add_free(offset, length);
-    ++num;
-    bytes += length;
+  if (_load_alloc_snapshot(&num, &bytes)) {
+    dout(1) << __func__ << " initialized from snapshot" << dendl;
+  } else {
+    // initialize from freelist
+    fm->enumerate_reset();
+    uint64_t offset, length;
+    while (fm->enumerate_next(db, &offset, &length)) {
+      alloc->init_add_free(offset, length);
+      ++num;
+      bytes += length;
+    }
+    fm->enumerate_reset();
   }
-  fm->enumerate_reset();
 
   // also mark bluefs space as allocated
   for (auto e = bluefs_extents.begin(); e != bluefs_extents.end(); ++e) {
@@ -5105,6 +5114,111 @@ int BlueStore::_open_alloc()
   return 0;
 }
 
+// Try to initialize the allocator from the free space saved by the last
+// clean umount.  The snapshot holds the freelist view of free space, i.e.
+// including the extents owned by bluefs, so the caller still has to
+// remove bluefs_extents afterwards.
+bool BlueStore::_load_alloc_snapshot(uint64_t *num, uint64_t *bytes)
+{
+  bufferlist bl;
+  bl.swap(alloc_snapshot);
+  if (bl.length() == 0 ||
+      !cct->_conf.get_val<bool>("bluestore_alloc_snapshot")) {
+    return false;
+  }
+
+  uint64_t size, alloc_size;
+  interval_set<uint64_t> free;
+  try {
+    auto p = bl.cbegin();
+    DECODE_START(1, p);
+    decode(size, p);
+    decode(alloc_size, p);
+    decode(free, p);
+    DECODE_FINISH(p);
+  } catch (ceph::buffer::error& e) {
+    derr << __func__ << " unable to decode allocator snapshot: "
+	 << e.what() << dendl;
+    return false;
+  }
+  if (size != fm->get_size() || alloc_size != fm->get_alloc_size()) {
+    dout(1) << __func__ << " ignoring snapshot for size 0x" << std::hex << size
+	    << "/0x" << alloc_size << ", freelist has 0x" << fm->get_size()
+	    << "/0x" << fm->get_alloc_size() << std::dec << dendl;
+    return false;
+  }
+
+  // cheap sanity check: the head of the freelist must match
+  bool match = true;
+  fm->enumerate_reset();
+  auto it = free.begin();
+  for (unsigned i = 0; i < 16; ++i, ++it) {
+    uint64_t offset, length;
+    bool have_fm = fm->enumerate_next(db, &offset, &length);
+    bool have_snap = it != free.end();
+    if (have_fm != have_snap) {
+      match = false;
+    } else if (have_fm &&
+	       (offset != it.get_start() || length != it.get_len())) {
+      match = false;
+    }
+    if (!match || !have_fm) {
+      break;
+    }
+  }
+  fm->enumerate_reset();
+  if (!match) {
+    derr << __func__ << " allocator snapshot does not match freelist, "
+	 << "ignoring it" << dendl;
+    return false;
+  }
+
+  for (auto e = free.begin(); e != free.end(); ++e) {
+    alloc->init_add_free(e.get_start(), e.get_len());
+    ++(*num);
+    *bytes += e.get_len();
+  }
+  return true;
+}
+
+// Save the allocator state so that the next mount can skip the freelist
+// scan.  Must be called with no transactions in flight; the snapshot is
+// dropped by the next read/write _open_db.
+void BlueStore::_write_alloc_snapshot()
+{
+  if (!cct->_conf.get_val<bool>("bluestore_alloc_snapshot")) {
+    return;
+  }
+  if (alloc_snapshot_stale) {
+    dout(1) << __func__ << " skipped, store has been repaired" << dendl;
+    return;
+  }
+  ceph_assert(db && fm && alloc);
+  auto start = mono_clock::now();
+
+  // pending discards still hold released space
+  bdev->discard_drain();
+
+  interval_set<uint64_t> free = bluefs_extents;
+  alloc->dump([&](uint64_t offset, uint64_t length) {
+    free.union_insert(offset, length);
+  });
+
+  bufferlist bl;
+  ENCODE_START(1, 1, bl);
+  encode(fm->get_size(), bl);
+  encode(fm->get_alloc_size(), bl);
+  encode(free, bl);
+  ENCODE_FINISH(bl);
+
+  KeyValueDB::Transaction t = db->get_transaction();
+  t->set(PREFIX_SUPER, "alloc_snapshot", bl);
+  db->submit_transaction_sync(t);
+  dout(1) << __func__ << " saved " << free.num_intervals() << " extents ("
+	  << bl.length() << " bytes) in "
+	  << ceph::timespan_str(mono_clock::now() - start) << dendl;
+}
+
 void BlueStore::_close_alloc()
 {
   ceph_assert(bdev);
@@ -5115,6 +5229,8 @@ void BlueStore::_close_alloc()
   delete alloc;
   alloc = NULL;
   bluefs_extents.clear();
+  alloc_snapshot.clear();
+  alloc_snapshot_stale = false;
 }
 
 int BlueStore::_open_fsid(bool create)
@@ -5790,6 +5906,21 @@ int BlueStore::_open_db(bool create, bool to_repair_db, bool read_only)
     _close_db(read_only);
     return -EIO;
   }
+  if (!create) {
+    // the allocator snapshot is only valid until the store is modified,
+    // so stash it for _open_alloc and drop it on any read/write open
+    bufferlist bl;
+    if (db->get(PREFIX_SUPER, "alloc_snapshot", &bl) >= 0 && bl.length()) {
+      if (!alloc) {
+	alloc_snapshot.claim(bl);
+      }
+      if (!read_only) {
+	KeyValueDB::Transaction t = db->get_transaction();
+	t->rmkey(PREFIX_SUPER, "alloc_snapshot");
+	db->submit_transaction_sync(t);
+      }
+    }
+  }
   dout(1) << __func__ << " opened " << kv_backend
 	  << " path " << fn << " options " << options << dendl;
   return 0;
@@ -7003,6 +7134,8 @@ int BlueStore::_mount(bool kv_only, bool open_db)
     }
   }
 
+  _defrag_start();
+
   mounted = true;
   return 0;
 
@@ -7026,6 +7159,9 @@ int BlueStore::umount()
   ceph_assert(_kv_only || mounted);
   dout(1) << __func__ << dendl;
 
+  if (!_kv_only) {
+    _defrag_stop();
+  }
   _osr_drain_all();
 
   mounted = false;
@@ -7034,6 +7170,7 @@ int BlueStore::umount()
     dout(20) << __func__ << " stopping kv thread" << dendl;
     _kv_stop();
     _flush_cache();
+    _write_alloc_snapshot();
     dout(20) << __func__ << " closing" << dendl;
 
   }
@@ -7719,6 +7856,97 @@ public:
   };
 };
 
+/*
+ * Deep fsck reads every object back to verify it against its checksums,
+ * which dominates the run time on large rotational devices.  The reads
+ * are handed to a few worker threads while the main thread carries on
+ * with the (inherently sequential) metadata checks.  Each worker holds
+ * at most bluestore_fsck_read_bytes_cap of data at a time, and the
+ * number of decoded onodes waiting for a worker is bounded.
+ */
+struct BlueStore::FSCKDeepReadWQ
+  : public ThreadPool::WorkQueueVal<std::pair<CollectionRef, OnodeRef>> {
+  typedef std::pair<CollectionRef, OnodeRef> item_t;
+
+  BlueStore* store;
+  const size_t max_in_flight;
+
+  std::list<item_t> items; ///< protected by the thread pool lock
+
+  ceph::mutex lock = ceph::make_mutex("BlueStore::FSCKDeepReadWQ::lock");
+  ceph::condition_variable cond;
+  size_t in_flight = 0;    ///< queued or being read
+  std::atomic<int64_t> errors = {0};
+
+  FSCKDeepReadWQ(BlueStore* _store, size_t _max_in_flight, ThreadPool* tp)
+    : ThreadPool::WorkQueueVal<item_t>("BlueStore::FSCKDeepReadWQ",
+				       time_t(), time_t(), tp),
+      store(_store),
+      max_in_flight(_max_in_flight) {
+  }
+
+  void _enqueue(item_t item) override {
+    items.push_back(item);
+  }
+  void _enqueue_front(item_t item) override {
+    items.push_front(item);
+  }
+  bool _empty() override {
+    return items.empty();
+  }
+  item_t _dequeue() override {
+    ceph_assert(!items.empty());
+    item_t item = items.front();
+    items.pop_front();
+    return item;
+  }
+  void _process(item_t item, ThreadPool::TPHandle&) override {
+    errors += store->_fsck_read_object(item.first.get(), item.second);
+    std::lock_guard l(lock);
+    --in_flight;
+    cond.notify_all();
+  }
+
+  void queue_read(CollectionRef c, OnodeRef o) {
+    {
+      std::unique_lock l(lock);
+      cond.wait(l, [this] { return in_flight < max_in_flight; });
+      ++in_flight;
+    }
+    queue(std::make_pair(c, o));
+  }
+  int64_t wait_for_reads() {
+    std::unique_lock l(lock);
+    cond.wait(l, [this] { return in_flight == 0; });
+    return errors;
+  }
+};
+
+int64_t BlueStore::_fsck_read_object(Collection* c, OnodeRef& o)
+{
+  int64_t errors = 0;
+  std::shared_lock cl(c->lock);
+  bufferlist bl;
+  uint64_t max_read_block = cct->_conf->bluestore_fsck_read_bytes_cap;
+  uint64_t offset = 0;
+  do {
+    uint64_t l = std::min(uint64_t(o->onode.size - offset), max_read_block);
+    int r = _do_read(c, o, offset, l, bl,
+      CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+    if (r < 0) {
+      ++errors;
+      derr << "fsck error: " << o->oid << std::hex
+        << " error during read: "
+        << " " << offset << "~" << l
+        << " " << cpp_strerror(r) << std::dec
+        << dendl;
+      break;
+    }
+    offset += l;
+  } while (offset < o->onode.size);
+  return errors;
+}
+
 void BlueStore::_fsck_check_object_omap(FSCKDepth depth,
   OnodeRef& o,
   const BlueStore::FSCK_ObjectCtx& ctx)
@@ -7816,6 +8044,17 @@ void BlueStore::_fsck_check_objects(FSCKDepth depth,
   auto it = db->get_iterator(PREFIX_OBJ, KeyValueDB::ITERATOR_NOCACHE);
   mempool::bluestore_fsck::list<string> expecting_shards;
   if (it) {
+    const size_t read_thread_count = depth == FSCK_DEEP ?
+      cct->_conf.get_val<uint64_t>("bluestore_fsck_deep_read_threads") : 0;
+    ThreadPool read_thread_pool(cct, "FSCKDeepReadThreadPool", "DeepFSCK",
+				read_thread_count);
+    std::unique_ptr<FSCKDeepReadWQ> read_wq;
+    if (read_thread_count > 0) {
+      read_wq.reset(new FSCKDeepReadWQ(this, read_thread_count * 4,
+				       &read_thread_pool));
+      read_thread_pool.start();
+    }
+
     const size_t thread_count = cct->_conf->bluestore_fsck_quick_fix_threads;
     typedef ShallowFSCKThreadPool::FSCKWorkQueue<256> WQ;
     std::unique_ptr<WQ> wq(
@@ -8022,27 +8261,19 @@ void BlueStore::_fsck_check_objects(FSCKDepth depth,
           }
         } // if (o->onode.has_omap())
         if (depth == FSCK_DEEP) {
-          bufferlist bl;
-          uint64_t max_read_block = cct->_conf->bluestore_fsck_read_bytes_cap;
-          uint64_t offset = 0;
-          do {
-            uint64_t l = std::min(uint64_t(o->onode.size - offset), max_read_block);
-            int r = _do_read(c.get(), o, offset, l, bl,
-              CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
-            if (r < 0) {
-              ++errors;
-              derr << "fsck error: " << oid << std::hex
-                << " error during read: "
-                << " " << offset << "~" << l
-                << " " << cpp_strerror(r) << std::dec
-                << dendl;
-              break;
-            }
-            offset += l;
-          } while (offset < o->onode.size);
+          if (read_wq) {
+            read_wq->queue_read(c, o);
+          } else {
+            errors += _fsck_read_object(c.get(), o);
+          }
         } // deep
       } //if (depth != FSCK_SHALLOW)
     } // for (it->lower_bound(string()); it->valid(); it->next())
+    if (read_wq) {
+      errors += read_wq->wait_for_reads();
+      read_thread_pool.stop();
+      read_wq.reset();
+    }
     if (depth == FSCK_SHALLOW && thread_count > 0) {
       wq->finalize(thread_pool, ctx);
       if (processed_myself) {
@@ -8815,6 +9046,10 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
 
     dout(5) << __func__ << " applying repair results" << dendl;
     repaired = repairer.apply(db);
+    if (repaired) {
+      // the allocator was loaded before the freelist got fixed
+      alloc_snapshot_stale = true;
+    }
     dout(5) << __func__ << " repair applied" << dendl;
   }
 
@@ -9865,6 +10100,128 @@ int BlueStore::_do_read(
   return r;
 }
 
+int BlueStore::verify_data(
+  CollectionHandle &c_,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t length,
+  uint32_t op_flags)
+{
+  Collection *c = static_cast<Collection *>(c_.get());
+  dout(15) << __func__ << " " << c->get_cid() << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length << std::dec
+	   << dendl;
+  if (!c->exists)
+    return -ENOENT;
+  if (cct->_conf->bluestore_ignore_data_csum)
+    return -EOPNOTSUPP;
+
+  int r;
+  {
+    std::shared_lock l(c->lock);
+    OnodeRef o = c->get_onode(oid, false);
+    if (!o || !o->exists) {
+      r = -ENOENT;
+      goto out;
+    }
+    r = _do_verify_data(o, offset, length, op_flags);
+    if (r == -EIO) {
+      logger->inc(l_bluestore_read_eio);
+    }
+  }
+
+ out:
+  if (r >= 0 && _debug_data_eio(oid)) {
+    r = -EIO;
+    derr << __func__ << " " << c->cid << " " << oid << " INJECT EIO" << dendl;
+  }
+  dout(10) << __func__ << " " << c->get_cid() << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length << std::dec
+	   << " = " << r << dendl;
+  return r;
+}
+
+// Same device reads as _do_read() with BYPASS_CLEAN_CACHE, but each blob
+// is only checked against its stored csums: compressed blobs are not
+// decompressed and nothing is assembled into a result buffer.
+int BlueStore::_do_verify_data(
+  OnodeRef o,
+  uint64_t offset,
+  size_t length,
+  uint32_t op_flags,
+  uint64_t retry_count)
+{
+  if (offset >= o->onode.size) {
+    return 0;
+  }
+  if (offset + length > o->onode.size) {
+    length = o->onode.size - offset;
+  }
+  o->extent_map.fault_range(db, offset, length);
+
+  // dirty buffers are not on disk yet; there is nothing to verify there
+  ready_regions_t ready_regions;
+  blobs2read_t blobs2read;
+  _read_cache(o, offset, length, BufferSpace::BYPASS_CLEAN_CACHE,
+	      ready_regions, blobs2read);
+  for (auto& p : blobs2read) {
+    if (!p.first->get_blob().has_csum()) {
+      dout(20) << __func__ << " blob " << *p.first << " has no csum" << dendl;
+      return -EOPNOTSUPP;
+    }
+  }
+
+  vector<bufferlist> compressed_blob_bls;
+  IOContext ioc(cct, NULL, true); // allow EIO
+  int r = _prepare_read_ioc(blobs2read, &compressed_blob_bls, &ioc);
+  if (r < 0)
+    return r;
+  if (ioc.has_pending_aios()) {
+    bdev->aio_submit(&ioc);
+    ioc.aio_wait();
+    r = ioc.get_return_value();
+    if (r < 0) {
+      ceph_assert(r == -EIO);
+      return -EIO;
+    }
+  }
+
+  bool csum_error = false;
+  auto p = compressed_blob_bls.begin();
+  for (auto& [bptr, r2r] : blobs2read) {
+    if (bptr->get_blob().is_compressed()) {
+      ceph_assert(p != compressed_blob_bls.end());
+      if (_verify_csum(o, &bptr->get_blob(), 0, *p++,
+		       r2r.front().regs.front().logical_offset) < 0) {
+	csum_error = true;
+	break;
+      }
+    } else {
+      for (auto& req : r2r) {
+	if (_verify_csum(o, &bptr->get_blob(), req.r_off, req.bl,
+			 req.regs.front().logical_offset) < 0) {
+	  csum_error = true;
+	  break;
+	}
+      }
+      if (csum_error) {
+	break;
+      }
+    }
+  }
+  if (csum_error) {
+    // see _do_read() about spurious csum errors
+    if (retry_count >= cct->_conf->bluestore_retry_disk_reads) {
+      return -EIO;
+    }
+    return _do_verify_data(o, offset, length, op_flags, retry_count + 1);
+  }
+  if (retry_count) {
+    logger->inc(l_bluestore_reads_with_retries);
+  }
+  return length;
+}
+
 int BlueStore::_verify_csum(OnodeRef& o,
 			    const bluestore_blob_t* blob, uint64_t blob_xoffset,
 			    const bufferlist& bl,
@@ -12095,6 +12452,260 @@ void BlueStore::_kv_finalize_thread()
   kv_finalize_started = false;
 }
 
+// The thread is started by the first _defrag_note(), so that stores
+// that never enable bluestore_defrag_bytes_per_sec don't run it at all.
+void BlueStore::_defrag_start()
+{
+  dout(10) << __func__ << dendl;
+  std::lock_guard l(defrag_lock);
+  defrag_stop = false;
+}
+
+void BlueStore::_defrag_stop()
+{
+  dout(10) << __func__ << dendl;
+  {
+    std::lock_guard l(defrag_lock);
+    defrag_stop = true;
+    defrag_cond.notify_all();
+  }
+  if (defrag_thread.is_started()) {
+    defrag_thread.join();
+  }
+  std::lock_guard l(defrag_lock);
+  defrag_queue.clear();
+  defrag_queued.clear();
+  logger->set(l_bluestore_defrag_queued, 0);
+}
+
+void BlueStore::_defrag_note(CollectionRef& c, OnodeRef& o)
+{
+  // temp objects are written through the PG's sequencer, not their
+  // collection's, so _defrag_object can't tell if they are idle
+  if (o->extent_map.extent_map.size() <
+      cct->_conf->bluestore_defrag_min_extents ||
+      c->cid.is_temp() || o->oid.hobj.is_temp()) {
+    return;
+  }
+  std::lock_guard l(defrag_lock);
+  if (defrag_stop ||
+      defrag_queue.size() >= 1024 ||
+      !defrag_queued.insert(o->oid).second) {
+    return;
+  }
+  dout(20) << __func__ << " " << c->cid << " " << o->oid
+	   << " " << o->extent_map.extent_map.size() << " extents" << dendl;
+  defrag_queue.emplace_back(c, o->oid);
+  logger->set(l_bluestore_defrag_queued, defrag_queue.size());
+  if (!defrag_thread.is_started()) {
+    defrag_thread.create("bstore_defrag");
+  }
+}
+
+// Drop queued entries whose collection goes away or changes shape;
+// _defrag_object checks again for the one it may be working on.
+void BlueStore::_defrag_forget(const Collection *c)
+{
+  std::lock_guard l(defrag_lock);
+  for (auto p = defrag_queue.begin(); p != defrag_queue.end(); ) {
+    if (p->first.get() == c) {
+      defrag_queued.erase(p->second);
+      p = defrag_queue.erase(p);
+    } else {
+      ++p;
+    }
+  }
+  logger->set(l_bluestore_defrag_queued, defrag_queue.size());
+}
+
+void BlueStore::_defrag_forget(const ghobject_t& oid)
+{
+  std::lock_guard l(defrag_lock);
+  if (!defrag_queued.erase(oid)) {
+    return;
+  }
+  for (auto p = defrag_queue.begin(); p != defrag_queue.end(); ++p) {
+    if (p->second == oid) {
+      defrag_queue.erase(p);
+      break;
+    }
+  }
+  logger->set(l_bluestore_defrag_queued, defrag_queue.size());
+}
+
+void BlueStore::_defrag_thread()
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock l(defrag_lock);
+  // token bucket, in bytes, refilled at bluestore_defrag_bytes_per_sec
+  double budget = 0;
+  auto last = mono_clock::now();
+  while (!defrag_stop) {
+    auto now = mono_clock::now();
+    uint64_t rate = cct->_conf->bluestore_defrag_bytes_per_sec;
+    budget = std::min<double>(budget + rate * std::chrono::duration<double>(
+				now - last).count(), rate);
+    last = now;
+    if (defrag_queue.empty() || budget <= 0) {
+      dout(20) << __func__ << " sleep" << dendl;
+      defrag_cond.wait_for(l, make_timespan(1));
+      continue;
+    }
+    auto [c, oid] = defrag_queue.front();
+    defrag_queue.pop_front();
+    l.unlock();
+
+    uint64_t bytes = 0;
+    int r = _defrag_object(c, oid, &bytes);
+    budget -= bytes;
+
+    l.lock();
+    if (r == -EAGAIN && !defrag_stop) {
+      // the sequencer is busy with client work; try again later
+      defrag_queue.emplace_back(c, oid);
+    } else {
+      defrag_queued.erase(oid);
+    }
+    logger->set(l_bluestore_defrag_queued, defrag_queue.size());
+    if (r == -EAGAIN) {
+      defrag_cond.wait_for(l, make_timespan(0.01));
+    }
+  }
+  dout(10) << __func__ << " finish" << dendl;
+}
+
+int BlueStore::_defrag_object(CollectionRef& c, const ghobject_t& oid,
+			      uint64_t *bytes)
+{
+  dout(15) << __func__ << " " << c->cid << " " << oid << dendl;
+  OpSequencer *osr = c->osr.get();
+  TransContext *txc = new TransContext(cct, c.get(), osr, nullptr);
+  txc->t = db->get_transaction();
+
+  // number of physically discontiguous runs backing the object
+  auto count_pextents = [](OnodeRef& o) {
+    uint64_t n = 0;
+    uint64_t end = 0;
+    for (auto& e : o->extent_map.extent_map) {
+      e.blob->get_blob().map(
+	e.blob_offset, e.length,
+	[&](uint64_t offset, uint64_t length) {
+	  if (offset != end) {
+	    ++n;
+	  }
+	  end = offset + length;
+	  return 0;
+	});
+    }
+    return n;
+  };
+
+  std::unique_lock l(c->lock);
+  OnodeRef o;
+  uint64_t before = 0;
+  // the object may have moved on since it was queued: a split or merge
+  // changes which objects the collection holds, and get_onode() would
+  // abort on one it no longer does
+  spg_t pgid;
+  if (c->exists && !c->cid.is_temp() && !oid.hobj.is_temp() &&
+      (!c->cid.is_pg(&pgid) || oid.match(c->cnode.bits, pgid.ps()))) {
+    o = c->get_onode(oid, false);
+  }
+  if (o && o->exists &&
+      o->onode.size <= cct->_conf->bluestore_defrag_max_object_size) {
+    o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
+    for (auto& e : o->extent_map.extent_map) {
+      if (e.blob->get_blob().is_shared() ||
+	  e.blob->get_blob().is_compressed()) {
+	// leave clones and compressed data alone
+	o.reset();
+	break;
+      }
+    }
+  } else {
+    o.reset();
+  }
+  if (o) {
+    before = count_pextents(o);
+    if (before < cct->_conf->bluestore_defrag_min_extents ||
+	alloc->get_free() < 2 * o->onode.size) {
+      o.reset();
+    }
+  }
+  if (!o) {
+    dout(20) << __func__ << " " << oid << " skipped" << dendl;
+    delete txc;
+    return 0;
+  }
+  // make sure no client txc is half prepared ahead of us; it would
+  // otherwise persist our onode changes before our own allocations
+  if (!osr->queue_new_if_idle(txc)) {
+    dout(20) << __func__ << " " << oid << " osr busy" << dendl;
+    delete txc;
+    return -EAGAIN;
+  }
+
+  // rewrite each run of contiguous logical extents in one go so that
+  // holes are preserved; the old extents are released once the txc
+  // commits and coalesce with their neighbours in the allocator
+  std::vector<std::pair<uint64_t, uint64_t>> runs;
+  for (auto& e : o->extent_map.extent_map) {
+    if (!runs.empty() && runs.back().first + runs.back().second ==
+	e.logical_offset) {
+      runs.back().second += e.length;
+    } else {
+      runs.emplace_back(e.logical_offset, e.length);
+    }
+  }
+  std::vector<bufferlist> data(runs.size());
+  int r = 0;
+  for (size_t i = 0; i < runs.size() && r >= 0; ++i) {
+    r = _do_read(c.get(), o, runs[i].first, runs[i].second, data[i],
+		 CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+  }
+  if (r >= 0) {
+    _assign_nid(txc, o);
+    for (size_t i = 0; i < runs.size(); ++i) {
+      _do_zero(txc, c, o, runs[i].first, runs[i].second);
+      r = _do_write(txc, c, o, runs[i].first, runs[i].second, data[i],
+		    CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+      ceph_assert(r == 0);
+      *bytes += runs[i].second;
+    }
+    txc->write_onode(o);
+  } else {
+    // nothing has been changed yet; let the empty txc pass through
+    derr << __func__ << " " << c->cid << " " << oid << " read error "
+	 << cpp_strerror(r) << dendl;
+    *bytes = 0;
+  }
+  uint64_t after = count_pextents(o);
+
+  // the onode is encoded by _txc_write_nodes and a client txc may touch
+  // it as soon as we let go of c->lock, so hold it until the kv
+  // transaction is complete
+  _txc_calc_cost(txc);
+  _txc_write_nodes(txc, txc->t);
+  _txc_journal_deferred(txc);
+  _txc_finalize_kv(txc, txc->t);
+  l.unlock();
+
+  _txc_throttle(txc, mono_clock::now());
+  logger->inc(l_bluestore_txc);
+  _txc_state_proc(txc);
+
+  if (r >= 0) {
+    dout(10) << __func__ << " " << c->cid << " " << oid
+	     << " 0x" << std::hex << *bytes << std::dec << " bytes, extents "
+	     << before << " -> " << after << dendl;
+    logger->inc(l_bluestore_defrag_objects);
+    logger->inc(l_bluestore_defrag_bytes, *bytes);
+    logger->inc(l_bluestore_defrag_extents_before, before);
+    logger->inc(l_bluestore_defrag_extents_after, after);
+  }
+  return r < 0 ? r : 0;
+}
+
 bluestore_deferred_op_t *BlueStore::_get_deferred_op(
   TransContext *txc)
 {
@@ -12146,6 +12757,18 @@ void BlueStore::deferred_try_submit()
   for (auto& osr : deferred_queue) {
     osrs.push_back(&osr);
   }
+  if (_use_rotational_settings()) {
+    // submit batches in ascending disk offset order so that the writes
+    // of all sequencers form a single sweep instead of random seeks
+    std::sort(osrs.begin(), osrs.end(),
+      [](const OpSequencerRef& a, const OpSequencerRef& b) {
+	auto first = [](const OpSequencerRef& o) {
+	  return o->deferred_pending && !o->deferred_pending->iomap.empty() ?
+	    o->deferred_pending->iomap.begin()->first : 0;
+	};
+	return first(a) < first(b);
+      });
+  }
   for (auto& osr : osrs) {
     if (osr->deferred_pending) {
       if (!osr->deferred_running) {
@@ -12217,6 +12840,7 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
     ++i;
   }
 
+  b->submitted = mono_clock::now();
   bdev->aio_submit(&b->ioc);
 }
 
@@ -12233,6 +12857,7 @@ void BlueStore::_deferred_aio_finish(OpSequencer *osr)
   dout(10) << __func__ << " osr " << osr << dendl;
   ceph_assert(osr->deferred_running);
   DeferredBatch *b = osr->deferred_running;
+  _deferred_batch_adapt(mono_clock::now() - b->submitted);
 
   {
     deferred_lock.lock();
@@ -12280,6 +12905,34 @@ void BlueStore::_deferred_aio_finish(OpSequencer *osr)
   }
 }
 
+// Resize the deferred flush threshold from the observed batch latency:
+// grow it slowly while batches complete within the target so that more
+// overwrites and adjacent writes get merged, and halve it as soon as the
+// device falls behind.
+void BlueStore::_deferred_batch_adapt(const ceph::timespan& lat)
+{
+  logger->tinc(l_bluestore_deferred_batch_lat, lat);
+  // the tunables may be changed by _set_alloc_sizes() at any time; the
+  // compare-exchange below keeps us from overwriting a fresh setting
+  const double target_lat = deferred_batch_target_lat;
+  if (target_lat <= 0) {
+    return;
+  }
+  int cur = deferred_batch_ops;
+  int next;
+  if (std::chrono::duration<double>(lat).count() > target_lat) {
+    next = std::max(deferred_batch_ops_min.load(), cur / 2);
+  } else {
+    next = std::min(deferred_batch_ops_max.load(), cur + std::max(1, cur / 8));
+  }
+  if (next != cur &&
+      deferred_batch_ops.compare_exchange_strong(cur, next)) {
+    dout(20) << __func__ << " lat " << lat << " deferred_batch_ops "
+	     << cur << " -> " << next << dendl;
+    logger->set(l_bluestore_deferred_batch_ops, next);
+  }
+}
+
 int BlueStore::_deferred_replay()
 {
   dout(10) << __func__ << " start" << dendl;
@@ -12358,15 +13011,7 @@ int BlueStore::queue_transactions(
 
   _txc_write_nodes(txc, txc->t);
 
-  // journal deferred items
-  if (txc->deferred_txn) {
-    txc->deferred_txn->seq = ++deferred_seq;
-    bufferlist bl;
-    encode(*txc->deferred_txn, bl);
-    string key;
-    get_deferred_key(txc->deferred_txn->seq, &key);
-    txc->t->set(PREFIX_DEFERRED, key, bl);
-  }
+  _txc_journal_deferred(txc);
 
   _txc_finalize_kv(txc, txc->t);
   if (handle)
@@ -12374,26 +13019,7 @@ int BlueStore::queue_transactions(
 
   auto tstart = mono_clock::now();
 
-  if (!throttle.try_start_transaction(
-	*db,
-	*txc,
-	tstart)) {
-    // ensure we do not block here because of deferred writes
-    dout(10) << __func__ << " failed get throttle_deferred_bytes, aggressive"
-	     << dendl;
-    ++deferred_aggressive;
-    deferred_try_submit();
-    {
-      // wake up any previously finished deferred events
-      std::lock_guard l(kv_lock);
-      if (!kv_sync_in_progress) {
-	kv_sync_in_progress = true;
-	kv_cond.notify_one();
-      }
-    }
-    throttle.finish_start_transaction(*db, *txc, tstart);
-    --deferred_aggressive;
-  }
+  _txc_throttle(txc, tstart);
   auto tend = mono_clock::now();
 
   if (handle)
@@ -12427,6 +13053,42 @@ int BlueStore::queue_transactions(
   return 0;
 }
 
+void BlueStore::_txc_journal_deferred(TransContext *txc)
+{
+  if (txc->deferred_txn) {
+    txc->deferred_txn->seq = ++deferred_seq;
+    bufferlist bl;
+    encode(*txc->deferred_txn, bl);
+    string key;
+    get_deferred_key(txc->deferred_txn->seq, &key);
+    txc->t->set(PREFIX_DEFERRED, key, bl);
+  }
+}
+
+void BlueStore::_txc_throttle(TransContext *txc, mono_clock::time_point tstart)
+{
+  if (!throttle.try_start_transaction(
+	*db,
+	*txc,
+	tstart)) {
+    // ensure we do not block here because of deferred writes
+    dout(10) << __func__ << " failed get throttle_deferred_bytes, aggressive"
+	     << dendl;
+    ++deferred_aggressive;
+    deferred_try_submit();
+    {
+      // wake up any previously finished deferred events
+      std::lock_guard l(kv_lock);
+      if (!kv_sync_in_progress) {
+	kv_sync_in_progress = true;
+	kv_cond.notify_one();
+      }
+    }
+    throttle.finish_start_transaction(*db, *txc, tstart);
+    --deferred_aggressive;
+  }
+}
+
 void BlueStore::_txc_aio_submit(TransContext *txc)
 {
   dout(10) << __func__ << " txc " << txc << dendl;
@@ -14227,6 +14889,9 @@ int BlueStore::_write(TransContext *txc,
     _assign_nid(txc, o);
     r = _do_write(txc, c, o, offset, length, bl, fadvise_flags);
     txc->write_onode(o);
+    if (r == 0 && cct->_conf->bluestore_defrag_bytes_per_sec) {
+      _defrag_note(c, o);
+    }
   }
   dout(10) << __func__ << " " << c->cid << " " << o->oid
 	   << " 0x" << std::hex << offset << "~" << length << std::dec
@@ -14452,6 +15117,7 @@ int BlueStore::_remove(TransContext *txc,
 	   << " onode " << o.get()
 	   << " txc "<< txc << dendl;
   int r = _do_remove(txc, c, o);
+  _defrag_forget(o->oid);
   dout(10) << __func__ << " " << c->cid << " " << o->oid << " = " << r << dendl;
   return r;
 }
@@ -14912,6 +15578,8 @@ int BlueStore::_rename(TransContext *txc,
   ghobject_t old_oid = oldo->oid;
   mempool::bluestore_cache_other::string new_okey;
 
+  _defrag_forget(old_oid);
+
   if (newo) {
     if (newo->exists) {
       r = -EEXIST;
@@ -15059,6 +15727,7 @@ int BlueStore::_remove_collection(TransContext *txc, const coll_t &cid,
 void BlueStore::_do_remove_collection(TransContext *txc,
 				      CollectionRef *c)
 {
+  _defrag_forget(c->get());
   coll_map.erase((*c)->cid);
   txc->removed_collections.push_back(*c);
   (*c)->exists = false;
@@ -15103,6 +15772,7 @@ int BlueStore::_split_collection(TransContext *txc,
   ceph_assert(d->cnode.bits == bits);
 
   c->split_cache(d.get());
+  _defrag_forget(c.get());
 
   // adjust bits.  note that this will be redundant for all but the first
   // split call for this parent (first child).
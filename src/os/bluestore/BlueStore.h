@@ -97,6 +97,8 @@ enum {
   l_bluestore_write_pad_bytes,
   l_bluestore_deferred_write_ops,
   l_bluestore_deferred_write_bytes,
+  l_bluestore_deferred_batch_ops,
+  l_bluestore_deferred_batch_lat,
   l_bluestore_write_penalty_read_ops,
   l_bluestore_allocated,
   l_bluestore_stored,
@@ -133,6 +135,11 @@ enum {
   l_bluestore_read_eio,
   l_bluestore_reads_with_retries,
   l_bluestore_fragmentation,
+  l_bluestore_defrag_queued,
+  l_bluestore_defrag_objects,
+  l_bluestore_defrag_bytes,
+  l_bluestore_defrag_extents_before,
+  l_bluestore_defrag_extents_after,
   l_bluestore_omap_seek_to_first_lat,
   l_bluestore_omap_upper_bound_lat,
   l_bluestore_omap_lower_bound_lat,
@@ -1058,7 +1065,8 @@ public:
     MEMPOOL_CLASS_HELPERS();
     // Not persisted and updated on cache insertion/removal
     OnodeCacheShard *s;
-    bool pinned = false; // Only to be used by the onode cache shard
+    /// set on lookup, cleared by the cache shard when trimming
+    std::atomic<bool> referenced = {false};
 
     std::atomic_int nref;  ///< reference count
     Collection *c;
@@ -1067,7 +1075,7 @@ public:
     /// key under PREFIX_OBJ where we are stored
     mempool::bluestore_cache_other::string key;
 
-    boost::intrusive::list_member_hook<> lru_item, pin_item;
+    boost::intrusive::list_member_hook<> lru_item;
 
     bluestore_onode_t onode;  ///< metadata stored as value in kv store
     bool exists;              ///< true if object logically exists
@@ -1122,17 +1130,14 @@ public:
     void dump(ceph::Formatter* f) const;
 
     void flush();
+    // onodes in use (nref > 1) stay on the cache shard's lru and are
+    // skipped by trim, so taking or dropping a reference never needs
+    // the cache shard lock.
     void get() {
-      if (++nref == 2 && s != nullptr) {
-        s->pin(*this);
-      }
+      ++nref;
     }
     void put() {
-      int n = --nref;
-      if (n == 1 && s != nullptr) {
-        s->unpin(*this);
-      }
-      if (n == 0) {
+      if (--nref == 0) {
 	delete this;
       }
     }
@@ -1198,6 +1203,7 @@ public:
 
   /// A Generic onode Cache Shard
   struct OnodeCacheShard : public CacheShard {
+    /// onodes found in use by the most recent trim
     std::atomic<uint64_t> num_pinned = {0};
 
     std::array<std::pair<ghobject_t, ceph::mono_clock::time_point>, 64> dumped_onodes;
@@ -1208,18 +1214,6 @@ public:
     virtual void _add(OnodeRef& o, int level) = 0;
     virtual void _rm(OnodeRef& o) = 0;
     virtual void _touch(OnodeRef& o) = 0;
-    virtual void _pin(Onode& o) = 0;
-    virtual void _unpin(Onode& o) = 0;
-
-    void pin(Onode& o) {
-      std::lock_guard l(lock);
-      _pin(o);
-    }
-
-    void unpin(Onode& o) {
-      std::lock_guard l(lock);
-      _unpin(o);
-    }
 
     virtual void add_stats(uint64_t *onodes, uint64_t *pinned_onodes) = 0;
     bool empty() {
@@ -1746,6 +1740,7 @@ public:
     std::map<uint64_t,deferred_io> iomap; ///< map of ios in this batch
     deferred_queue_t txcs;           ///< txcs in this batch
     IOContext ioc;                   ///< our aios
+    mono_clock::time_point submitted; ///< when aios were submitted
     /// bytes of pending io for each deferred seq (may be 0)
     std::map<uint64_t,int> seq_bytes;
 
@@ -1807,6 +1802,21 @@ public:
       q.push_back(*txc);
     }
 
+    /// queue txc unless some other txc is still being prepared, so that
+    /// background work cannot slip in between a client's txc creation
+    /// and the preparation of that txc
+    bool queue_new_if_idle(TransContext *txc) {
+      std::lock_guard l(qlock);
+      for (auto& i : q) {
+	if (i.state == TransContext::STATE_PREPARE) {
+	  return false;
+	}
+      }
+      txc->seq = ++last_seq;
+      q.push_back(*txc);
+      return true;
+    }
+
     void drain() {
       std::unique_lock l(qlock);
       while (!q.empty())
@@ -1916,6 +1926,15 @@ public:
     }
   };
 
+  struct DefragThread : public Thread {
+    BlueStore *store;
+    explicit DefragThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_defrag_thread();
+      return NULL;
+    }
+  };
+
   struct DBHistogram {
     struct value_dist {
       uint64_t count;
@@ -2000,6 +2019,9 @@ private:
   interval_set<uint64_t> bluefs_extents;  ///< block extents owned by bluefs
   interval_set<uint64_t> bluefs_extents_reclaiming; ///< currently reclaiming
 
+  bufferlist alloc_snapshot;          ///< free space saved at last umount
+  bool alloc_snapshot_stale = false;  ///< store repaired while mounted
+
   ceph::mutex deferred_lock = ceph::make_mutex("BlueStore::deferred_lock");
   std::atomic<uint64_t> deferred_seq = {0};
   deferred_osr_queue_t deferred_queue; ///< osr's with deferred io pending
@@ -2029,6 +2051,14 @@ private:
   std::deque<DeferredBatch*> deferred_stable_to_finalize; ///< pending finalization
   bool kv_finalize_in_progress = false;
 
+  DefragThread defrag_thread;
+  ceph::mutex defrag_lock = ceph::make_mutex("BlueStore::defrag_lock");
+  ceph::condition_variable defrag_cond;
+  bool defrag_stop = false;
+  /// objects found fragmented by writes, oldest first
+  std::deque<std::pair<CollectionRef, ghobject_t>> defrag_queue;
+  std::set<ghobject_t> defrag_queued;  ///< objects in defrag_queue
+
   PerfCounters *logger = nullptr;
 
   std::list<CollectionRef> removed_collections;
@@ -2058,6 +2088,12 @@ private:
 
   ///< number threshold for forced deferred writes
   std::atomic<int> deferred_batch_ops = {0};
+  ///< configured deferred_batch_ops, the floor for adaptive sizing
+  std::atomic<int> deferred_batch_ops_min = {0};
+  ///< upper bound for adaptive deferred_batch_ops
+  std::atomic<int> deferred_batch_ops_max = {0};
+  ///< target deferred batch latency in seconds, 0 for static batching
+  std::atomic<double> deferred_batch_target_lat = {0};
 
   ///< size threshold for forced deferred writes
   std::atomic<uint64_t> prefer_deferred_size = {0};
@@ -2298,6 +2334,8 @@ private:
   void _close_fm();
   int _write_out_fm_meta(uint64_t target_size);
   int _open_alloc();
+  bool _load_alloc_snapshot(uint64_t *num, uint64_t *bytes);
+  void _write_alloc_snapshot();
   void _close_alloc();
   int _open_collections();
   void _fsck_collections(int64_t* errors);
@@ -2361,6 +2399,8 @@ public:
 private:
   void _txc_finish_io(TransContext *txc);
   void _txc_finalize_kv(TransContext *txc, KeyValueDB::Transaction t);
+  void _txc_journal_deferred(TransContext *txc);
+  void _txc_throttle(TransContext *txc, ceph::mono_clock::time_point tstart);
   void _txc_apply_kv(TransContext *txc, bool sync_submit_transaction);
   void _txc_committed_kv(TransContext *txc);
   void _txc_finish(TransContext *txc);
@@ -2377,12 +2417,22 @@ private:
   void _kv_sync_thread();
   void _kv_finalize_thread();
 
+  void _defrag_start();
+  void _defrag_stop();
+  void _defrag_thread();
+  void _defrag_note(CollectionRef& c, OnodeRef& o);
+  void _defrag_forget(const Collection *c);
+  void _defrag_forget(const ghobject_t& oid);
+  int _defrag_object(CollectionRef& c, const ghobject_t& oid,
+		     uint64_t *bytes);
+
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc);
   void _deferred_queue(TransContext *txc);
 public:
   void deferred_try_submit();
 private:
   void _deferred_submit_unlock(OpSequencer *osr);
+  void _deferred_batch_adapt(const ceph::timespan& lat);
   void _deferred_aio_finish(OpSequencer *osr);
   int _deferred_replay();
 
@@ -2624,6 +2674,12 @@ public:
     size_t len,
     ceph::buffer::list& bl,
     uint32_t op_flags = 0) override;
+  int verify_data(
+    CollectionHandle &c,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    uint32_t op_flags = 0) override;
 
 private:
 
@@ -2708,6 +2764,13 @@ private:
     uint32_t op_flags = 0,
     uint64_t retry_count = 0);
 
+  int _do_verify_data(
+    OnodeRef o,
+    uint64_t offset,
+    size_t len,
+    uint32_t op_flags,
+    uint64_t retry_count = 0);
+
   int _do_readv(
     Collection *c,
     OnodeRef o,
@@ -3368,6 +3431,9 @@ private:
 
   void _fsck_check_objects(FSCKDepth depth,
     FSCK_ObjectCtx& ctx);
+
+  struct FSCKDeepReadWQ;
+  int64_t _fsck_read_object(Collection* c, OnodeRef& o);
 };
 
 inline std::ostream& operator<<(std::ostream& out, const BlueStore::volatile_statfs& s) {
@@ -70,7 +70,12 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
   unsigned int iodepth = cct->_conf->bdev_aio_max_queue_depth;
 
   if (use_ioring && ioring_queue_t::supported()) {
-    io_queue = std::make_unique<ioring_queue_t>(iodepth);
+    bool use_ioring_hipri = cct->_conf.get_val<bool>("bdev_ioring_hipri");
+    bool use_ioring_sqthread_poll = cct->_conf.get_val<bool>(
+      "bdev_ioring_sqthread_poll");
+    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri,
+						use_ioring_sqthread_poll);
+    io_queue_name = "io_uring";
   } else {
     static bool once;
     if (use_ioring && !once) {
@@ -79,6 +84,7 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
       once = true;
     }
     io_queue = std::make_unique<aio_queue_t>(iodepth);
+    io_queue_name = "libaio";
   }
 }
 
@@ -216,6 +222,7 @@ int KernelDevice::open(const string& p)
     goto out_fail;
   }
   _discard_start();
+  _init_logger();
 
   // round size down to an even block
   size &= ~(block_size - 1);
@@ -263,6 +270,7 @@ void KernelDevice::close()
   dout(1) << __func__ << dendl;
   _aio_stop();
   _discard_stop();
+  _shutdown_logger();
 
   if (vdo_fd >= 0) {
     VOID_TEMP_FAILURE_RETRY(::close(vdo_fd));
@@ -288,6 +296,7 @@ int KernelDevice::collect_metadata(const string& prefix, map<string,string> *pm)
   (*pm)[prefix + "size"] = stringify(get_size());
   (*pm)[prefix + "block_size"] = stringify(get_block_size());
   (*pm)[prefix + "driver"] = "KernelDevice";
+  (*pm)[prefix + "aio_engine"] = io_queue_name;
   if (rotational) {
     (*pm)[prefix + "type"] = "hdd";
   } else {
@@ -466,6 +475,55 @@ void KernelDevice::_aio_stop()
   }
 }
 
+void KernelDevice::_init_logger()
+{
+  // one instance per device (block, block.db, block.wal)
+  string name = "bdev";
+  if (auto pos = path.rfind('/'); pos != string::npos) {
+    name += "-" + path.substr(pos + 1);
+  }
+  PerfCountersBuilder b(cct, name, l_bdev_first, l_bdev_last);
+  b.add_u64_counter(l_bdev_aio_submit_batches, "aio_submit_batches",
+		    "Batches handed to the aio engine");
+  b.add_u64_counter(l_bdev_aio_submit_ops, "aio_submit_ops",
+		    "Aios handed to the aio engine");
+  b.add_u64_counter(l_bdev_aio_submit_retries, "aio_submit_retries",
+		    "Aio submissions retried because the queue was full");
+  b.add_time_avg(l_bdev_aio_submit_lat, "aio_submit_lat",
+		 "Average time spent submitting a batch to the aio engine");
+  b.add_u64_counter(l_bdev_aio_reap_batches, "aio_reap_batches",
+		    "Non-empty completion batches reaped from the aio engine");
+  b.add_u64_counter(l_bdev_aio_reap_ops, "aio_reap_ops",
+		    "Aio completions reaped from the aio engine");
+  b.add_u64_counter(l_bdev_write_rebuilds, "write_rebuilds",
+		    "Writes copied to satisfy direct io alignment");
+  b.add_u64_counter(l_bdev_write_rebuild_bytes, "write_rebuild_bytes",
+		    "Bytes of writes copied to satisfy direct io alignment",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+void KernelDevice::_rebuild_aligned(bufferlist& bl, bool buffered)
+{
+  const auto len = bl.length();
+  if ((!buffered || bl.get_num_buffers() >= IOV_MAX) &&
+      bl.rebuild_aligned_size_and_memory(block_size, block_size, IOV_MAX)) {
+    dout(20) << __func__ << " rebuilding buffer to be aligned" << dendl;
+    logger->inc(l_bdev_write_rebuilds);
+    logger->inc(l_bdev_write_rebuild_bytes, len);
+  }
+}
+
+void KernelDevice::_shutdown_logger()
+{
+  if (logger) {
+    cct->get_perfcounters_collection()->remove(logger);
+    delete logger;
+    logger = nullptr;
+  }
+}
+
 int KernelDevice::_discard_start()
 {
     discard_thread.create("bstore_discard");
@@ -530,6 +588,8 @@ void KernelDevice::_aio_thread()
     }
     if (r > 0) {
       dout(30) << __func__ << " got " << r << " completed aios" << dendl;
+      logger->inc(l_bdev_aio_reap_batches);
+      logger->inc(l_bdev_aio_reap_ops, r);
       for (int i = 0; i < r; ++i) {
 	IOContext *ioc = static_cast<IOContext*>(aio[i]->priv);
 	_aio_log_finish(ioc, aio[i]->offset, aio[i]->length);
@@ -787,11 +847,17 @@ void KernelDevice::aio_submit(IOContext *ioc)
 
   void *priv = static_cast<void*>(ioc);
   int r, retries = 0;
+  auto start = mono_clock::now();
   r = io_queue->submit_batch(ioc->running_aios.begin(), e,
 			     pending, priv, &retries);
+  logger->tinc(l_bdev_aio_submit_lat, mono_clock::now() - start);
+  logger->inc(l_bdev_aio_submit_batches);
+  logger->inc(l_bdev_aio_submit_ops, pending);
 
-  if (retries)
+  if (retries) {
     derr << __func__ << " retries " << retries << dendl;
+    logger->inc(l_bdev_aio_submit_retries, retries);
+  }
   if (r < 0) {
     derr << " aio submit got " << cpp_strerror(r) << dendl;
     ceph_assert(r == 0);
@@ -854,10 +920,7 @@ int KernelDevice::write(
     return 0;
   }
 
-  if ((!buffered || bl.get_num_buffers() >= IOV_MAX) &&
-      bl.rebuild_aligned_size_and_memory(block_size, block_size, IOV_MAX)) {
-    dout(20) << __func__ << " rebuilding buffer to be aligned" << dendl;
-  }
+  _rebuild_aligned(bl, buffered);
   dout(40) << "data: ";
   bl.hexdump(*_dout);
   *_dout << dendl;
@@ -883,10 +946,7 @@ int KernelDevice::aio_write(
     return 0;
   }
 
-  if ((!buffered || bl.get_num_buffers() >= IOV_MAX) &&
-      bl.rebuild_aligned_size_and_memory(block_size, block_size, IOV_MAX)) {
-    dout(20) << __func__ << " rebuilding buffer to be aligned" << dendl;
-  }
+  _rebuild_aligned(bl, buffered);
   dout(40) << "data: ";
   bl.hexdump(*_dout);
   *_dout << dendl;
@@ -21,12 +21,26 @@
 #include "include/interval_set.h"
 #include "common/Thread.h"
 #include "include/utime.h"
+#include "common/perf_counters.h"
 
 #include "ceph_aio.h"
 #include "BlockDevice.h"
 
 #define RW_IO_MAX (INT_MAX & CEPH_PAGE_MASK)
 
+enum {
+  l_bdev_first = 732700,
+  l_bdev_aio_submit_batches,
+  l_bdev_aio_submit_ops,
+  l_bdev_aio_submit_retries,
+  l_bdev_aio_submit_lat,
+  l_bdev_aio_reap_batches,
+  l_bdev_aio_reap_ops,
+  l_bdev_write_rebuilds,
+  l_bdev_write_rebuild_bytes,
+  l_bdev_last
+};
+
 
 class KernelDevice : public BlockDevice {
   std::vector<int> fd_directs, fd_buffereds;
@@ -46,6 +60,8 @@ class KernelDevice : public BlockDevice {
   ceph::mutex flush_mutex = ceph::make_mutex("KernelDevice::flush_mutex");
 
   std::unique_ptr<io_queue_t> io_queue;
+  std::string io_queue_name;  ///< "libaio" or "io_uring"
+  PerfCounters *logger = nullptr;
   aio_callback_t discard_callback;
   void *discard_callback_priv;
   bool aio_stop;
@@ -85,6 +101,10 @@ class KernelDevice : public BlockDevice {
   int _aio_start();
   void _aio_stop();
 
+  void _init_logger();
+  void _rebuild_aligned(ceph::buffer::list& bl, bool buffered);
+  void _shutdown_logger();
+
   int _discard_start();
   void _discard_stop();
 
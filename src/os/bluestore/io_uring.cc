@@ -8,10 +8,7 @@
 #include "liburing.h"
 #include <sys/epoll.h>
 
-/* Options */
-
-static bool hipri = false;      /* use IO polling */
-static bool sq_thread = false;  /* use kernel submission/poller thread */
+#include "common/ceph_time.h"
 
 struct ioring_data {
   struct io_uring io_uring;
@@ -73,30 +70,26 @@ static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 }
 
 static int ioring_queue(struct ioring_data *d, void *priv,
-			list<aio_t>::iterator beg, list<aio_t>::iterator end)
+			list<aio_t>::iterator& cur, list<aio_t>::iterator end)
 {
   struct io_uring *ring = &d->io_uring;
-  struct aio_t *io = nullptr;
-
-  ceph_assert(beg != end);
+  int queued = 0;
 
-  do {
+  while (cur != end) {
     struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
     if (!sqe)
+      /* SQ is full, hand what we have to the kernel first */
       break;
 
-    io = &*beg;
+    struct aio_t *io = &*cur;
     io->priv = priv;
 
     init_sqe(d, sqe, io);
+    ++queued;
+    ++cur;
+  }
 
-  } while (++beg != end);
-
-  if (!io)
-    /* Queue is full, go and reap something first */
-    return 0;
-
-  return io_uring_submit(ring);
+  return queued;
 }
 
 static void build_fixed_fds_map(struct ioring_data *d,
@@ -108,9 +101,11 @@ static void build_fixed_fds_map(struct ioring_data *d,
   }
 }
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_) :
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_) :
   d(make_unique<ioring_data>()),
-  iodepth(iodepth_)
+  iodepth(iodepth_),
+  hipri(hipri_),
+  sq_thread(sq_thread_)
 {
 }
 
@@ -131,6 +126,12 @@ int ioring_queue_t::init(std::vector<int> &fds)
     flags |= IORING_SETUP_SQPOLL;
 
   int ret = io_uring_queue_init(iodepth, &d->io_uring, flags);
+  if (ret == -EPERM && sq_thread) {
+    /* SQPOLL needs CAP_SYS_ADMIN on kernels older than 5.11 */
+    sq_thread = false;
+    flags &= ~IORING_SETUP_SQPOLL;
+    ret = io_uring_queue_init(iodepth, &d->io_uring, flags);
+  }
   if (ret < 0)
     return ret;
 
@@ -180,13 +181,49 @@ int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
                                  int *retries)
 {
   (void)aios_size;
-  (void)retries;
+
+  // same backoff as aio_queue_t::submit_batch: ~16 seconds max sleep
+  int attempts = 16;
+  int delay = 125;
+  int done = 0;
+  int r;
 
   pthread_mutex_lock(&d->sq_mutex);
-  int rc = ioring_queue(d.get(), priv, beg, end);
+  while (true) {
+    done += ioring_queue(d.get(), priv, beg, end);
+    r = io_uring_submit(&d->io_uring);
+    if (r < 0 && r != -EAGAIN && r != -EBUSY)
+      break;
+    if (r >= 0 && beg == end) {
+      r = done;
+      break;
+    }
+    if (r > 0) {
+      /* SQ was full, but the kernel made room for the rest */
+      attempts = 16;
+      delay = 125;
+      continue;
+    }
+    /*
+     * Out of kernel resources or too many completions left unreaped.
+     * Sqes that were not consumed stay in the ring and get picked up
+     * by the next io_uring_submit(), so just wait for the aio thread.
+     */
+    if (attempts-- <= 0) {
+      /* give up with aios still unqueued, like aio_queue_t does */
+      if (r >= 0)
+	r = -EAGAIN;
+      break;
+    }
+    pthread_mutex_unlock(&d->sq_mutex);
+    usleep(delay);
+    delay *= 2;
+    (*retries)++;
+    pthread_mutex_lock(&d->sq_mutex);
+  }
   pthread_mutex_unlock(&d->sq_mutex);
 
-  return rc;
+  return r;
 }
 
 int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
@@ -196,7 +233,26 @@ get_cqe:
   int events = ioring_get_cqe(d.get(), max, paio);
   pthread_mutex_unlock(&d->cq_mutex);
 
-  if (events == 0) {
+  if (events == 0 && hipri) {
+    /*
+     * IOPOLL rings never signal the ring fd: completions only reach the
+     * CQ ring when someone polls the device for them, which the kernel
+     * does in io_uring_enter(2) with IORING_ENTER_GETEVENTS (peeking at
+     * the CQ ring doesn't).  With min_complete of 0 that is a single
+     * polling pass, so we enforce the timeout ourselves.
+     */
+    auto deadline = ceph::mono_clock::now() +
+      std::chrono::milliseconds(timeout_ms);
+    do {
+      int ret = io_uring_enter(d->io_uring.ring_fd, 0, 0,
+			       IORING_ENTER_GETEVENTS, NULL);
+      if (ret < 0 && errno != EAGAIN && errno != EINTR)
+	return -errno;
+      pthread_mutex_lock(&d->cq_mutex);
+      events = ioring_get_cqe(d.get(), max, paio);
+      pthread_mutex_unlock(&d->cq_mutex);
+    } while (events == 0 && ceph::mono_clock::now() < deadline);
+  } else if (events == 0) {
     struct epoll_event ev;
     int ret = epoll_wait(d->epoll_fd, &ev, 1, timeout_ms);
     if (ret < 0)
@@ -227,7 +283,7 @@ bool ioring_queue_t::supported()
 
 struct ioring_data {};
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_)
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
 {
   ceph_assert(0);
 }
@@ -109,6 +109,7 @@ ostream &operator<<(ostream &lhs, const ECBackend::read_request_t &rhs)
   return lhs << "read_request_t(to_read=[" << rhs.to_read << "]"
 	     << ", need=" << rhs.need
 	     << ", want_attrs=" << rhs.want_attrs
+	     << ", partial=" << rhs.partial
 	     << ")";
 }
 
@@ -173,8 +174,11 @@ ostream &operator<<(ostream &lhs, const ECBackend::Op &rhs)
       << " pending_apply=" << rhs.pending_apply
       << " pending_commit=" << rhs.pending_commit
       << " plan.to_read=" << rhs.plan.to_read
-      << " plan.will_write=" << rhs.plan.will_write
-      << ")";
+      << " plan.will_write=" << rhs.plan.will_write;
+  if (rhs.plan.delta) {
+    lhs << " plan.delta_extent=" << rhs.plan.delta_extent;
+  }
+  lhs << ")";
   return lhs;
 }
 
@@ -1211,7 +1215,9 @@ void ECBackend::handle_sub_read_reply(
       ceph_assert(req_iter != rop.to_read.find(i->first)->second.to_read.end());
       ceph_assert(riter != rop.complete[i->first].returned.end());
       pair<uint64_t, uint64_t> adjusted =
-	sinfo.aligned_offset_len_to_chunk(
+	get_shard_read_range(
+	  rop.to_read.find(i->first)->second,
+	  from.shard,
 	  make_pair(req_iter->get<0>(), req_iter->get<1>()));
       ceph_assert(adjusted.first == j->first);
       riter->get<2>()[from].claim(j->second);
@@ -1751,11 +1757,13 @@ void ECBackend::do_read_op(ReadOp &op)
 	   i->second.to_read.begin();
 	 j != i->second.to_read.end();
 	 ++j) {
-      pair<uint64_t, uint64_t> chunk_off_len =
-	sinfo.aligned_offset_len_to_chunk(make_pair(j->get<0>(), j->get<1>()));
       for (auto k = i->second.need.begin();
 	   k != i->second.need.end();
 	   ++k) {
+	pair<uint64_t, uint64_t> chunk_off_len =
+	  get_shard_read_range(
+	    i->second, k->first.shard, make_pair(j->get<0>(), j->get<1>()));
+	ceph_assert(chunk_off_len.second);
 	messages[k->first].to_read[i->first].push_back(
 	  boost::make_tuple(
 	    chunk_off_len.first,
@@ -1798,6 +1806,19 @@ void ECBackend::do_read_op(ReadOp &op)
   dout(10) << __func__ << ": started " << op << dendl;
 }
 
+pair<uint64_t, uint64_t> ECBackend::get_shard_read_range(
+  const read_request_t &req,
+  int shard,
+  pair<uint64_t, uint64_t> in) const
+{
+  if (!req.partial)
+    return sinfo.aligned_offset_len_to_chunk(in);
+  int chunk = get_data_chunk_index(shard);
+  if (chunk < 0)
+    return sinfo.offset_len_to_parity_range(in);
+  return sinfo.offset_len_to_chunk_range(in, chunk);
+}
+
 ECUtil::HashInfoRef ECBackend::get_hash_info(
   const hobject_t &hoid, bool checks, const map<string,bufferptr> *attrs)
 {
@@ -1874,6 +1895,7 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
       return ref;
     },
     get_parent()->get_dpp());
+  op->plan.delta = want_delta_write(op);
 
   dout(10) << __func__ << ": " << *op << dendl;
 
@@ -1881,6 +1903,221 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
   check_ops();
 }
 
+bool ECBackend::want_delta_write(Op *op)
+{
+  auto &plan = op->plan;
+  if (!cct->_conf->osd_ec_parity_delta_writes ||
+      !get_parent()->get_pool().allows_ecoverwrites() ||
+      !ec_impl->supports_parity_delta() ||
+      !ec_impl->get_chunk_mapping().empty() ||
+      ec_impl->get_sub_chunk_count() != 1 ||
+      plan.invalidates_cache ||
+      plan.to_read.size() != 1 ||
+      plan.t->op_map.size() != 1) {
+    return false;
+  }
+  const hobject_t &hoid = plan.t->op_map.begin()->first;
+  const auto &oop = plan.t->op_map.begin()->second;
+  if (hoid.is_temp() ||
+      !oop.is_none() ||
+      oop.truncate ||
+      oop.buffer_updates.empty()) {
+    return false;
+  }
+  using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
+  uint64_t start = oop.buffer_updates.begin().get_off();
+  uint64_t end = start;
+  for (auto &&i : oop.buffer_updates) {
+    if (boost::get<BufferUpdate::CloneRange>(&i.get_val())) {
+      return false;
+    }
+    end = std::max(end, i.get_off() + i.get_len());
+  }
+  auto extent = ECTransaction::get_delta_extent(start, end - start);
+  auto hiter = plan.hash_infos.find(hoid);
+  ceph_assert(hiter != plan.hash_infos.end());
+  if (extent.first + extent.second >
+      hiter->second->get_projected_total_logical_size(sinfo)) {
+    return false;
+  }
+
+  // the data chunks rewritten and all the coding chunks must be read
+  set<int> want;
+  sinfo.offset_len_to_data_chunks(extent, &want);
+  if (want.size() >= ec_impl->get_data_chunk_count()) {
+    return false;
+  }
+  for (unsigned i = ec_impl->get_data_chunk_count();
+       i < ec_impl->get_chunk_count();
+       ++i) {
+    want.insert(i);
+  }
+  set<int> have;
+  map<shard_id_t, pg_shard_t> shards;
+  set<pg_shard_t> error_shards;
+  get_all_avail_shards(hoid, error_shards, have, shards, false);
+  for (auto i : want) {
+    if (!have.count(i)) {
+      return false;
+    }
+  }
+  plan.delta_extent[hoid] = extent;
+  return true;
+}
+
+bool ECBackend::writes_in_flight(const Op *op, bool uncached_only) const
+{
+  for (auto *l : {&waiting_reads, &waiting_commit}) {
+    for (auto &&i : *l) {
+      if (uncached_only && i.using_cache) {
+	continue;
+      }
+      for (auto &&w : op->plan.will_write) {
+	if (i.plan.will_write.count(w.first)) {
+	  return true;
+	}
+      }
+    }
+  }
+  return false;
+}
+
+struct DeltaReadContext :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  ECBackend *ec;
+  ECBackend::Op *op;
+  hobject_t hoid;
+  DeltaReadContext(ECBackend *ec, ECBackend::Op *op, const hobject_t &hoid)
+    : ec(ec), op(op), hoid(hoid) {}
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ECBackend::read_result_t &res = in.second;
+    op->delta_read_pending = false;
+    if (res.r == 0 && res.errors.empty() && res.partial) {
+      ceph_assert(res.returned.size() == 1);
+      auto &dst = op->plan.delta_read[hoid];
+      for (auto &&j : res.returned.front().get<2>()) {
+	dst[j.first.shard].claim(j.second);
+      }
+    } else {
+      // a shard failed, fall back to a full stripe read-modify-write
+      op->plan.delta = false;
+      op->plan.delta_extent.clear();
+      op->plan.delta_read.clear();
+      op->remote_read = op->plan.to_read;
+      if (res.r == 0 && res.errors.empty() && use_stripes(res)) {
+	// send_all_remaining_reads already read the whole stripes
+	ldpp_dout(ec->get_parent()->get_dpp(), 10)
+	  << "DeltaReadContext: " << hoid << " using the full stripe read"
+	  << dendl;
+      } else {
+	ldpp_dout(ec->get_parent()->get_dpp(), 10)
+	  << "DeltaReadContext: " << hoid << " read failed r=" << res.r
+	  << ", reading whole stripes" << dendl;
+	ec->start_remote_read(op);
+      }
+    }
+    ec->check_ops();
+  }
+
+  /// decode the stripes of a complete read into the op's remote read
+  /// result, if they cover what a full stripe rmw needs
+  bool use_stripes(ECBackend::read_result_t &res) {
+    extent_map decoded;
+    extent_set have;
+    for (auto &&read : res.returned) {
+      map<int, bufferlist> to_decode;
+      for (auto &&j : read.get<2>()) {
+	to_decode[j.first.shard].claim(j.second);
+      }
+      bufferlist bl;
+      if (ECUtil::decode(ec->sinfo, ec->ec_impl, to_decode, &bl) < 0) {
+	return false;
+      }
+      have.insert(read.get<0>(), bl.length());
+      decoded.insert(read.get<0>(), bl.length(), std::move(bl));
+    }
+    auto &&to_read = op->plan.to_read[hoid];
+    extent_map result;
+    for (auto i = to_read.begin(); i != to_read.end(); ++i) {
+      if (!have.contains(i.get_start(), i.get_len())) {
+	return false;
+      }
+      result.insert(decoded.intersect(i.get_start(), i.get_len()));
+    }
+    op->remote_read_result.emplace(hoid, std::move(result));
+    return true;
+  }
+};
+
+bool ECBackend::start_delta_read(Op *op)
+{
+  ceph_assert(op->plan.delta_extent.size() == 1);
+  const hobject_t &hoid = op->plan.delta_extent.begin()->first;
+  const pair<uint64_t, uint64_t> &extent =
+    op->plan.delta_extent.begin()->second;
+
+  set<int> want;
+  sinfo.offset_len_to_data_chunks(extent, &want);
+  for (unsigned i = ec_impl->get_data_chunk_count();
+       i < ec_impl->get_chunk_count();
+       ++i) {
+    want.insert(i);
+  }
+  map<pg_shard_t, vector<pair<int, int>>> shards;
+  set<int> have;
+  map<shard_id_t, pg_shard_t> avail;
+  set<pg_shard_t> error_shards;
+  get_all_avail_shards(hoid, error_shards, have, avail, false);
+  for (auto i : want) {
+    auto j = avail.find(shard_id_t(i));
+    if (j == avail.end()) {
+      dout(10) << __func__ << ": " << hoid << " shard " << i
+	       << " is unavailable" << dendl;
+      return false;
+    }
+    shards[j->second].push_back(make_pair(0, 1));
+  }
+
+  list<boost::tuple<uint64_t, uint64_t, uint32_t> > offsets;
+  offsets.push_back(boost::make_tuple(extent.first, extent.second, 0));
+  map<hobject_t, read_request_t> for_read_op;
+  for_read_op.insert(
+    make_pair(
+      hoid,
+      read_request_t(
+	offsets,
+	shards,
+	false,
+	new DeltaReadContext(this, op, hoid),
+	true)));
+  map<hobject_t, set<int>> obj_want_to_read;
+  obj_want_to_read.insert(make_pair(hoid, want));
+
+  dout(10) << __func__ << ": " << hoid << " " << extent
+	   << " from " << shards << dendl;
+  op->delta_read_pending = true;
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    obj_want_to_read,
+    for_read_op,
+    OpRequestRef(),
+    false, false);
+  return true;
+}
+
+void ECBackend::start_remote_read(Op *op)
+{
+  ceph_assert(get_parent()->get_pool().allows_ecoverwrites());
+  objects_read_async_no_cache(
+    op->remote_read,
+    [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
+      for (auto &&i: results) {
+	op->remote_read_result.emplace(i.first, i.second.second);
+      }
+      check_ops();
+    });
+}
+
 bool ECBackend::try_state_to_reads()
 {
   if (waiting_state.empty())
@@ -1896,7 +2133,20 @@ bool ECBackend::try_state_to_reads()
     return false;
   }
 
-  if (!pipeline_state.caching_enabled()) {
+  if (op->plan.delta && writes_in_flight(op, false)) {
+    dout(20) << __func__ << ": blocking " << *op
+	     << " because it reads old data which an op in flight writes"
+	     << dendl;
+    return false;
+  }
+  if (op->requires_rmw() && writes_in_flight(op, true)) {
+    dout(20) << __func__ << ": blocking " << *op
+	     << " because an op in flight writes the same object without"
+	     << " the cache" << dendl;
+    return false;
+  }
+
+  if (!pipeline_state.caching_enabled() || op->plan.delta) {
     op->using_cache = false;
   } else if (op->invalidates_cache()) {
     dout(20) << __func__ << ": invalidating cache after this op"
@@ -1938,18 +2188,19 @@ bool ECBackend::try_state_to_reads()
     op->remote_read = op->plan.to_read;
   }
 
+  if (op->plan.delta) {
+    if (start_delta_read(op)) {
+      op->remote_read.clear();
+    } else {
+      op->plan.delta = false;
+      op->plan.delta_extent.clear();
+    }
+  }
+
   dout(10) << __func__ << ": " << *op << dendl;
 
   if (!op->remote_read.empty()) {
-    ceph_assert(get_parent()->get_pool().allows_ecoverwrites());
-    objects_read_async_no_cache(
-      op->remote_read,
-      [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
-	for (auto &&i: results) {
-	  op->remote_read_result.emplace(i.first, i.second.second);
-	}
-	check_ops();
-      });
+    start_remote_read(op);
   }
 
   return true;
@@ -2031,7 +2282,8 @@ bool ECBackend::try_reads_to_commit()
     written_set[i.first] = i.second.get_interval_set();
   }
   dout(20) << __func__ << ": written_set: " << written_set << dendl;
-  ceph_assert(written_set == op->plan.will_write);
+  // a delta write leaves nothing for the cache
+  ceph_assert(op->plan.delta || written_set == op->plan.will_write);
 
   if (op->using_cache) {
     for (auto &&hpair: written) {
@@ -2201,11 +2453,9 @@ void ECBackend::objects_read_async(
 	 to_read.begin();
        i != to_read.end();
        ++i) {
-    pair<uint64_t, uint64_t> tmp =
-      sinfo.offset_len_to_stripe_bounds(
-	make_pair(i->first.get<0>(), i->first.get<1>()));
-
-    es.union_insert(tmp.first, tmp.second);
+    // objects_read_and_reconstruct widens these to stripe bounds if the
+    // data shards cannot be read directly
+    es.union_insert(i->first.get<0>(), i->first.get<1>());
     flags |= i->first.get<2>();
   }
 
@@ -2322,6 +2572,26 @@ struct CallClientContexts :
       goto out;
     ceph_assert(res.returned.size() == to_read.size());
     ceph_assert(res.errors.empty());
+    if (res.partial) {
+      for (auto &&read: to_read) {
+	ceph_assert(res.returned.front().get<0>() == read.get<0>() &&
+	       res.returned.front().get<1>() == read.get<1>());
+	map<int, bufferlist> chunks;
+	for (auto &&j : res.returned.front().get<2>()) {
+	  chunks[ec->get_data_chunk_index(j.first.shard)].claim(j.second);
+	}
+	bufferlist bl;
+	ECUtil::assemble(
+	  ec->sinfo, read.get<0>(), read.get<1>(), chunks, &bl);
+	// the shards are padded to a full stripe, as a decode would be
+	if (bl.length() < read.get<1>()) {
+	  bl.append_zero(read.get<1>() - bl.length());
+	}
+	result.insert(read.get<0>(), bl.length(), std::move(bl));
+	res.returned.pop_front();
+      }
+      goto out;
+    }
     for (auto &&read: to_read) {
       pair<uint64_t, uint64_t> adjusted =
 	ec->sinfo.offset_len_to_stripe_bounds(
@@ -2382,6 +2652,29 @@ void ECBackend::objects_read_and_reconstruct(
   map<hobject_t, read_request_t> for_read_op;
   for (auto &&to_read: reads) {
     map<pg_shard_t, vector<pair<int, int>>> shards;
+    set<int> partial_want;
+    if (want_partial_read(to_read.first, to_read.second, fast_read,
+			  &partial_want, &shards)) {
+      dout(20) << __func__ << " " << to_read.first << " " << to_read.second
+	       << " from " << shards << dendl;
+      CallClientContexts *c = new CallClientContexts(
+	to_read.first,
+	this,
+	&(in_progress_client_reads.back()),
+	to_read.second);
+      for_read_op.insert(
+	make_pair(
+	  to_read.first,
+	  read_request_t(
+	    to_read.second,
+	    shards,
+	    false,
+	    c,
+	    true)));
+      obj_want_to_read.insert(make_pair(to_read.first, partial_want));
+      continue;
+    }
+
     int r = get_min_avail_to_read_shards(
       to_read.first,
       want_to_read,
@@ -2390,16 +2683,30 @@ void ECBackend::objects_read_and_reconstruct(
       &shards);
     ceph_assert(r == 0);
 
+    // whole stripes are decoded
+    uint32_t flags = 0;
+    extent_set es;
+    for (auto &&e : to_read.second) {
+      pair<uint64_t, uint64_t> tmp =
+	sinfo.offset_len_to_stripe_bounds(make_pair(e.get<0>(), e.get<1>()));
+      es.union_insert(tmp.first, tmp.second);
+      flags |= e.get<2>();
+    }
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > offsets;
+    for (auto j = es.begin(); j != es.end(); ++j) {
+      offsets.push_back(boost::make_tuple(j.get_start(), j.get_len(), flags));
+    }
+
     CallClientContexts *c = new CallClientContexts(
       to_read.first,
       this,
       &(in_progress_client_reads.back()),
-      to_read.second);
+      offsets);
     for_read_op.insert(
       make_pair(
 	to_read.first,
 	read_request_t(
-	  to_read.second,
+	  offsets,
 	  shards,
 	  false,
 	  c)));
@@ -2416,6 +2723,51 @@ void ECBackend::objects_read_and_reconstruct(
 }
 
 
+bool ECBackend::want_partial_read(
+  const hobject_t &hoid,
+  const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read,
+  bool fast_read,
+  set<int> *want,
+  map<pg_shard_t, vector<pair<int, int>>> *shards)
+{
+  if (fast_read ||
+      !cct->_conf->osd_ec_partial_reads ||
+      ec_impl->get_sub_chunk_count() != 1 ||
+      to_read.empty()) {
+    return false;
+  }
+  // every shard must read a range for each extent
+  bool aligned = true;
+  for (auto &&e : to_read) {
+    set<int> w;
+    get_want_to_read_shards(e.get<0>(), e.get<1>(), &w);
+    if (w.empty() || (!want->empty() && w != *want)) {
+      return false;
+    }
+    want->swap(w);
+    aligned = aligned &&
+      sinfo.logical_offset_is_stripe_aligned(e.get<0>()) &&
+      sinfo.logical_offset_is_stripe_aligned(e.get<1>());
+  }
+  if (aligned && want->size() == ec_impl->get_data_chunk_count()) {
+    // nothing to trim
+    return false;
+  }
+  int r = get_min_avail_to_read_shards(hoid, *want, false, false, shards);
+  if (r < 0 || shards->size() != want->size()) {
+    shards->clear();
+    return false;
+  }
+  for (auto &&i : *shards) {
+    if (!want->count(i.first.shard)) {
+      // a data shard is missing and would have to be decoded
+      shards->clear();
+      return false;
+    }
+  }
+  return true;
+}
+
 int ECBackend::send_all_remaining_reads(
   const hobject_t &hoid,
   ReadOp &rop)
@@ -2425,14 +2777,39 @@ int ECBackend::send_all_remaining_reads(
   for (set<pg_shard_t>::iterator i = ots.begin(); i != ots.end(); ++i)
     already_read.insert(i->shard);
   dout(10) << __func__ << " have/error shards=" << already_read << dendl;
+
+  list<boost::tuple<uint64_t, uint64_t, uint32_t> > offsets =
+    rop.to_read.find(hoid)->second.to_read;
+  if (rop.to_read.find(hoid)->second.partial) {
+    // a data shard failed; the partial ranges read so far are useless
+    // for decoding, so start over with whole stripes
+    dout(10) << __func__ << " " << hoid << " falling back to full stripe reads"
+	     << dendl;
+    already_read.clear();
+    rop.want_to_read[hoid].clear();
+    get_want_to_read_shards(&rop.want_to_read[hoid]);
+    auto &res = rop.complete[hoid];
+    res.partial = false;
+    res.returned.clear();
+    for (auto &&e : offsets) {
+      pair<uint64_t, uint64_t> tmp =
+	sinfo.offset_len_to_stripe_bounds(make_pair(e.get<0>(), e.get<1>()));
+      e.get<0>() = tmp.first;
+      e.get<1>() = tmp.second;
+      res.returned.push_back(
+	boost::make_tuple(
+	  tmp.first,
+	  tmp.second,
+	  map<pg_shard_t, bufferlist>()));
+    }
+  }
+
   map<pg_shard_t, vector<pair<int, int>>> shards;
   int r = get_remaining_shards(hoid, already_read, rop.want_to_read[hoid],
 			       rop.complete[hoid], &shards, rop.for_recovery);
   if (r)
     return r;
 
-  list<boost::tuple<uint64_t, uint64_t, uint32_t> > offsets =
-    rop.to_read.find(hoid)->second.to_read;
   GenContext<pair<RecoveryMessages *, read_result_t& > &> *c =
     rop.to_read.find(hoid)->second.cb;
 
@@ -2541,6 +2918,7 @@ int ECBackend::be_deep_scrub(
   }
   if (r > 0) {
     pos.data_hash << bl;
+    pos.bytes_read += r;
   }
   pos.data_pos += r;
   if (r == (int)stride) {
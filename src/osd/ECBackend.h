@@ -135,6 +135,11 @@ public:
    * still only perform a client read from shards in the acting std::set.  This
    * ensures that we won't ever have to restart a client initiated read in
    * check_recovery_sources.
+   *
+   * Reads need not be stripe aligned.  If the data shards covering every
+   * extent of an object are readable, only the covered part of each of
+   * those chunks is read (@see read_request_t::partial); otherwise whole
+   * stripes are read and decoded.
    */
   void objects_read_and_reconstruct(
     const std::map<hobject_t, std::list<boost::tuple<uint64_t, uint64_t, uint32_t> >
@@ -215,6 +220,27 @@ private:
       want_to_read->insert(chunk);
     }
   }
+  /// shards holding the data of the logical range @off~@len
+  void get_want_to_read_shards(
+    uint64_t off, uint64_t len, std::set<int> *want_to_read) const {
+    const std::vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+    std::set<int> chunks;
+    sinfo.offset_len_to_data_chunks(std::make_pair(off, len), &chunks);
+    for (auto i : chunks) {
+      int chunk = (int)chunk_mapping.size() > i ? chunk_mapping[i] : i;
+      want_to_read->insert(chunk);
+    }
+  }
+  /// data chunk index stored on @shard, -1 for a coding shard
+  int get_data_chunk_index(int shard) const {
+    const std::vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+    for (int i = 0; i < (int)ec_impl->get_data_chunk_count(); ++i) {
+      int chunk = (int)chunk_mapping.size() > i ? chunk_mapping[i] : i;
+      if (chunk == shard)
+	return i;
+    }
+    return -1;
+  }
 
   /**
    * Recovery
@@ -348,6 +374,9 @@ public:
     std::list<
       boost::tuple<
 	uint64_t, uint64_t, std::map<pg_shard_t, ceph::buffer::list> > > returned;
+    /// returned holds the exact ranges of the data shards, see
+    /// read_request_t::partial
+    bool partial = false;
     read_result_t() : r(0) {}
   };
   struct read_request_t {
@@ -355,13 +384,17 @@ public:
     const std::map<pg_shard_t, std::vector<std::pair<int, int>>> need;
     const bool want_attrs;
     GenContext<std::pair<RecoveryMessages *, read_result_t& > &> *cb;
+    /// to_read is not stripe aligned and each shard in need only reads
+    /// the part of its data chunk covering it; nothing is decoded
+    const bool partial;
     read_request_t(
       const std::list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read,
       const std::map<pg_shard_t, std::vector<std::pair<int, int>>> &need,
       bool want_attrs,
-      GenContext<std::pair<RecoveryMessages *, read_result_t& > &> *cb)
+      GenContext<std::pair<RecoveryMessages *, read_result_t& > &> *cb,
+      bool partial = false)
       : to_read(to_read), need(need), want_attrs(want_attrs),
-	cb(cb) {}
+	cb(cb), partial(partial) {}
   };
   friend ostream &operator<<(ostream &lhs, const read_request_t &rhs);
 
@@ -402,6 +435,7 @@ public:
 	for_recovery(for_recovery), want_to_read(std::move(_want_to_read)),
 	to_read(std::move(_to_read)) {
       for (auto &&hpair: to_read) {
+	complete[hpair.first].partial = hpair.second.partial;
 	auto &returned = complete[hpair.first].returned;
 	for (auto &&extent: hpair.second.to_read) {
 	  returned.push_back(
@@ -432,6 +466,18 @@ public:
     bool do_redundant_reads, bool for_recovery);
 
   void do_read_op(ReadOp &rop);
+  /// range of @shard's chunk read for the logical range @in of @req
+  std::pair<uint64_t, uint64_t> get_shard_read_range(
+    const read_request_t &req, int shard,
+    std::pair<uint64_t, uint64_t> in) const;
+  /// true if @to_read can be served from the data shards alone, which
+  /// are returned in @want and @shards
+  bool want_partial_read(
+    const hobject_t &hoid,
+    const std::list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read,
+    bool fast_read,
+    std::set<int> *want,
+    std::map<pg_shard_t, std::vector<std::pair<int, int>>> *shards);
   int send_all_remaining_reads(
     const hobject_t &hoid,
     ReadOp &rop);
@@ -485,8 +531,10 @@ public:
     std::map<hobject_t,extent_set> pending_read; // subset already being read
     std::map<hobject_t,extent_set> remote_read;  // subset we must read
     std::map<hobject_t,extent_map> remote_read_result;
+    bool delta_read_pending = false; // reading old data for plan.delta
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return delta_read_pending ||
+	(!remote_read.empty() && remote_read_result.empty());
     }
 
     /// In progress write state.
@@ -565,6 +613,17 @@ public:
   eversion_t completed_to;
   eversion_t committed_to;
   void start_rmw(Op *op, PGTransactionUPtr &&t);
+  /// true if @op can update the coding shards from the difference
+  /// between the old and new data, see osd_ec_parity_delta_writes
+  bool want_delta_write(Op *op);
+  /// true if an op past waiting_state writes an object @op writes;
+  /// if @uncached_only, only ops bypassing the cache count
+  bool writes_in_flight(const Op *op, bool uncached_only) const;
+  /// read the old data and coding for @op's delta write, false if a
+  /// shard needed is unavailable
+  bool start_delta_read(Op *op);
+  void start_remote_read(Op *op);
+  friend struct DeltaReadContext;
   bool try_state_to_reads();
   bool try_reads_to_commit();
   bool try_finish_rmw();
@@ -29,6 +29,7 @@ using std::string;
 using std::vector;
 
 using ceph::bufferlist;
+using ceph::bufferptr;
 using ceph::decode;
 using ceph::encode;
 using ceph::ErasureCodeInterfaceRef;
@@ -71,6 +72,11 @@ void encode_and_write(
   }
 
   for (auto &&i : *transactions) {
+    if (!want.count(i.first)) {
+      // the chunk is unchanged
+      ceph_assert(offset < before_size);
+      continue;
+    }
     ceph_assert(buffers.count(i.first));
     bufferlist &enc_bl = buffers[i.first];
     if (offset >= before_size) {
@@ -92,6 +98,164 @@ void encode_and_write(
   }
 }
 
+/// shards whose chunks change when @modified is rewritten within the
+/// stripe aligned extent @off~@len: the coding shards and the data
+/// shards holding any modified byte
+static set<int> get_overwrite_shards(
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const extent_set &modified,
+  uint64_t off,
+  uint64_t len) {
+  const vector<int> &chunk_mapping = ecimpl->get_chunk_mapping();
+  auto chunk_to_shard = [&](int i) {
+    return (int)chunk_mapping.size() > i ? chunk_mapping[i] : i;
+  };
+  set<int> want;
+  for (unsigned i = 0; i < ecimpl->get_chunk_count(); ++i) {
+    want.insert(i);
+  }
+  for (unsigned i = 0; i < ecimpl->get_data_chunk_count(); ++i) {
+    want.erase(chunk_to_shard(i));
+  }
+  extent_set range;
+  range.insert(off, len);
+  extent_set touched;
+  touched.intersection_of(modified, range);
+  set<int> data;
+  for (auto i = touched.begin(); i != touched.end(); ++i) {
+    sinfo.offset_len_to_data_chunks(
+      make_pair(i.get_start(), i.get_len()), &data);
+  }
+  for (auto i : data) {
+    want.insert(chunk_to_shard(i));
+  }
+  return want;
+}
+
+/// rewrite the logical extent @extent of @oid with @to_write, given
+/// the old content @old of the shards it touches: only the data shards
+/// holding the extent and the coding shards are written, the latter
+/// updated with the difference between the old and new data
+static void delta_overwrite(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  pair<uint64_t, uint64_t> extent,
+  map<int, bufferlist> &old,
+  const extent_map &to_write,
+  uint32_t flags,
+  pg_log_entry_t *entry,
+  vector<pair<uint64_t, uint64_t> > &rollback_extents,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp) {
+  ceph_assert(ecimpl->get_chunk_mapping().empty());
+  const int k = ecimpl->get_data_chunk_count();
+  const pair<uint64_t, uint64_t> parity =
+    sinfo.offset_len_to_parity_range(extent);
+  ceph_assert(parity.second);
+
+  map<int, bufferlist> old_data;
+  map<int, bufferptr> coding;
+  for (auto &&i : old) {
+    if (i.first < k) {
+      old_data[i.first] = i.second;
+    } else {
+      ceph_assert(i.second.length() == parity.second);
+      bufferptr p(ceph::buffer::create_page_aligned(parity.second));
+      i.second.begin().copy(parity.second, p.c_str());
+      coding[i.first] = p;
+    }
+  }
+  ceph_assert(coding.size() == ecimpl->get_coding_chunk_count());
+
+  bufferlist old_bl;
+  ECUtil::assemble(sinfo, extent.first, extent.second, old_data, &old_bl);
+  ceph_assert(old_bl.length() == extent.second);
+  extent_map updated;
+  updated.insert(extent.first, extent.second, old_bl);
+  for (auto &&i : to_write) {
+    updated.insert(i.get_off(), i.get_len(), i.get_val());
+  }
+  bufferlist new_bl;
+  for (auto &&i : updated) {
+    new_bl.append(i.get_val());
+  }
+  ceph_assert(new_bl.length() == extent.second);
+  map<int, bufferlist> new_data;
+  ECUtil::split(sinfo, extent.first, extent.second, new_bl, &new_data);
+
+  // each delta spans the coding range and is zero where its chunk is
+  // not rewritten
+  map<int, bufferptr> deltas;
+  for (auto &&i : new_data) {
+    pair<uint64_t, uint64_t> range =
+      sinfo.offset_len_to_chunk_range(extent, i.first);
+    bufferlist &o = old_data[i.first];
+    ceph_assert(o.length() == range.second);
+    ceph_assert(i.second.length() == range.second);
+    o.c_str();
+    i.second.c_str();
+    bufferptr delta(ceph::buffer::create_page_aligned(parity.second));
+    delta.zero();
+    bufferptr d(delta, range.first - parity.first, range.second);
+    ecimpl->encode_delta(o.front(), i.second.front(), &d);
+    deltas[i.first] = delta;
+  }
+  ecimpl->apply_delta(deltas, coding);
+
+  ldpp_dout(dpp, 20) << __func__ << ": " << oid << " " << extent
+		     << " coding range " << parity
+		     << " data shards " << new_data.size() << dendl;
+
+  // the coding range covers the range written on every shard
+  if (entry) {
+    if (rollback_extents.empty()) {
+      for (auto &&st : *transactions) {
+	st.second.touch(
+	  coll_t(spg_t(pgid, st.first)),
+	  ghobject_t(oid, entry->version.version, st.first));
+      }
+    }
+    rollback_extents.emplace_back(parity);
+    for (auto &&st : *transactions) {
+      st.second.clone_range(
+	coll_t(spg_t(pgid, st.first)),
+	ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	ghobject_t(oid, entry->version.version, st.first),
+	parity.first,
+	parity.second,
+	parity.first);
+    }
+  }
+  for (auto &&st : *transactions) {
+    int shard = st.first;
+    bufferlist bl;
+    uint64_t off;
+    if (shard < k) {
+      auto i = new_data.find(shard);
+      if (i == new_data.end()) {
+	// the chunk is unchanged
+	continue;
+      }
+      off = sinfo.offset_len_to_chunk_range(extent, shard).first;
+      bl.claim(i->second);
+    } else {
+      ceph_assert(coding.count(shard));
+      off = parity.first;
+      bl.append(coding[shard]);
+    }
+    st.second.write(
+      coll_t(spg_t(pgid, st.first)),
+      ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+      off,
+      bl.length(),
+      bl,
+      flags);
+  }
+}
+
 bool ECTransaction::requires_overwrite(
   uint64_t prev_size,
   const PGTransaction::ObjectOperation &op) {
@@ -413,6 +577,9 @@ void ECTransaction::generate_transactions(
 
       uint64_t new_size = orig_size;
       uint64_t append_after = new_size;
+      // logical ranges whose contents change, as opposed to the rest of
+      // the stripes they fall in
+      extent_set modified;
       ldpp_dout(dpp, 20) << __func__ << ": new_size start " << new_size << dendl;
       if (op.truncate && op.truncate->first < new_size) {
 	ceph_assert(!op.is_fresh_object());
@@ -421,6 +588,8 @@ void ECTransaction::generate_transactions(
 	ldpp_dout(dpp, 20) << __func__ << ": new_size truncate down "
 			   << new_size << dendl;
 	if (new_size != op.truncate->first) { // 0 the unaligned part
+	  modified.union_insert(
+	    op.truncate->first, new_size - op.truncate->first);
 	  bufferlist bl;
 	  bl.append_zero(new_size - op.truncate->first);
 	  to_write.insert(
@@ -499,6 +668,7 @@ void ECTransaction::generate_transactions(
 	uint64_t off = extent.get_off();
 	uint64_t len = extent.get_len();
 	uint64_t end = off + len;
+	modified.union_insert(off, len);
 	ldpp_dout(dpp, 20) << __func__ << ": adding buffer_update "
 			   << make_pair(off, len)
 			   << dendl;
@@ -549,6 +719,27 @@ void ECTransaction::generate_transactions(
 			   << dendl;
       }
 
+      auto diter = plan.delta_read.find(oid);
+      if (diter != plan.delta_read.end()) {
+	ceph_assert(new_size == orig_size);
+	auto eiter = plan.delta_extent.find(oid);
+	ceph_assert(eiter != plan.delta_extent.end());
+	delta_overwrite(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  eiter->second,
+	  diter->second,
+	  to_write,
+	  fadvise_flags,
+	  entry,
+	  rollback_extents,
+	  transactions,
+	  dpp);
+	to_write.clear();
+      }
+
       set<int> want;
       for (unsigned i = 0; i < ecimpl->get_chunk_count(); ++i) {
 	want.insert(i);
@@ -587,12 +778,17 @@ void ECTransaction::generate_transactions(
 	      restore_from);
 	  }
 	}
+	// only rewrite the chunks which change
+	set<int> overwrite_want = get_overwrite_shards(
+	  sinfo, ecimpl, modified, extent.get_off(), extent.get_len());
+	ldpp_dout(dpp, 20) << __func__ << ": overwriting shards "
+			   << overwrite_want << dendl;
 	encode_and_write(
 	  pgid,
 	  oid,
 	  sinfo,
 	  ecimpl,
-	  want,
+	  overwrite_want,
 	  extent.get_off(),
 	  extent.get_val(),
 	  fadvise_flags,
@@ -30,8 +30,24 @@ namespace ECTransaction {
     std::map<hobject_t,extent_set> will_write; // superset of to_read
 
     std::map<hobject_t,ECUtil::HashInfoRef> hash_infos;
+
+    // parity delta overwrite: the logical extent rewritten and the old
+    // content of each shard it touches, keyed by shard
+    bool delta = false;
+    std::map<hobject_t,std::pair<uint64_t, uint64_t>> delta_extent;
+    std::map<hobject_t,std::map<int, ceph::buffer::list>> delta_read;
   };
 
+  /// logical extent rewritten by a parity delta overwrite of
+  /// @off~@len: widened to whole symbols of any supported code
+  inline std::pair<uint64_t, uint64_t> get_delta_extent(
+    uint64_t off, uint64_t len) {
+    constexpr uint64_t align = 8;
+    uint64_t start = off - off % align;
+    uint64_t end = (off + len + align - 1) / align * align;
+    return std::make_pair(start, end - start);
+  }
+
   bool requires_overwrite(
     uint64_t prev_size,
     const PGTransaction::ObjectOperation &op);
@@ -1,6 +1,7 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 
 #include <errno.h>
+#include <limits>
 #include "include/encoding.h"
 #include "ECUtil.h"
 
@@ -9,6 +10,123 @@ using ceph::bufferlist;
 using ceph::ErasureCodeInterfaceRef;
 using ceph::Formatter;
 
+pair<uint64_t, uint64_t> ECUtil::stripe_info_t::offset_len_to_chunk_range(
+  pair<uint64_t, uint64_t> in, unsigned chunk) const
+{
+  if (in.second == 0)
+    return make_pair(0, 0);
+  const uint64_t end = in.first + in.second;
+  const uint64_t first = in.first / stripe_width;
+  const uint64_t last = (end - 1) / stripe_width;
+  const uint64_t chunk_off = chunk * chunk_size;
+
+  // the range covers whole chunks on every stripe between first and
+  // last, so only the ends need trimming
+  uint64_t start;
+  uint64_t lo = std::max(in.first, first * stripe_width + chunk_off);
+  if (lo < first * stripe_width + chunk_off + chunk_size && lo < end) {
+    start = first * chunk_size + (lo - first * stripe_width - chunk_off);
+  } else {
+    start = (first + 1) * chunk_size;
+  }
+  uint64_t stop;
+  uint64_t hi = std::min(end, last * stripe_width + chunk_off + chunk_size);
+  if (hi > last * stripe_width + chunk_off && hi > in.first) {
+    stop = last * chunk_size + (hi - last * stripe_width - chunk_off);
+  } else {
+    stop = last * chunk_size;
+  }
+  if (start >= stop)
+    return make_pair(0, 0);
+  return make_pair(start, stop - start);
+}
+
+void ECUtil::stripe_info_t::offset_len_to_data_chunks(
+  pair<uint64_t, uint64_t> in, set<int> *chunks) const
+{
+  for (unsigned i = 0; i < get_data_chunk_count(); ++i) {
+    if (offset_len_to_chunk_range(in, i).second) {
+      chunks->insert(i);
+    }
+  }
+}
+
+pair<uint64_t, uint64_t> ECUtil::stripe_info_t::offset_len_to_parity_range(
+  pair<uint64_t, uint64_t> in) const
+{
+  uint64_t start = std::numeric_limits<uint64_t>::max();
+  uint64_t stop = 0;
+  for (unsigned i = 0; i < get_data_chunk_count(); ++i) {
+    auto r = offset_len_to_chunk_range(in, i);
+    if (r.second) {
+      start = std::min(start, r.first);
+      stop = std::max(stop, r.first + r.second);
+    }
+  }
+  if (start >= stop)
+    return make_pair(0, 0);
+  return make_pair(start, stop - start);
+}
+
+void ECUtil::assemble(
+  const stripe_info_t &sinfo,
+  uint64_t offset,
+  uint64_t len,
+  map<int, bufferlist> &chunks,
+  bufferlist *out)
+{
+  ceph_assert(out);
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  map<int, uint64_t> chunk_start;
+  for (auto &&i : chunks) {
+    chunk_start[i.first] = sinfo.offset_len_to_chunk_range(
+      make_pair(offset, len), i.first).first;
+  }
+  uint64_t pos = offset;
+  const uint64_t end = offset + len;
+  while (pos < end) {
+    int chunk = (pos % stripe_width) / chunk_size;
+    uint64_t in_chunk = pos % chunk_size;
+    uint64_t l = std::min(chunk_size - in_chunk, end - pos);
+    auto i = chunks.find(chunk);
+    ceph_assert(i != chunks.end());
+    uint64_t off = (pos / stripe_width) * chunk_size + in_chunk -
+      chunk_start[chunk];
+    if (off >= i->second.length())
+      break;
+    uint64_t got = std::min(l, i->second.length() - off);
+    bufferlist bl;
+    bl.substr_of(i->second, off, got);
+    out->claim_append(bl);
+    if (got < l)
+      break;
+    pos += l;
+  }
+}
+
+void ECUtil::split(
+  const stripe_info_t &sinfo,
+  uint64_t offset,
+  uint64_t len,
+  const bufferlist &in,
+  map<int, bufferlist> *chunks)
+{
+  ceph_assert(in.length() == len);
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  uint64_t pos = offset;
+  const uint64_t end = offset + len;
+  while (pos < end) {
+    int chunk = (pos % stripe_width) / chunk_size;
+    uint64_t l = std::min(chunk_size - pos % chunk_size, end - pos);
+    bufferlist bl;
+    bl.substr_of(in, pos - offset, l);
+    (*chunks)[chunk].claim_append(bl);
+    pos += l;
+  }
+}
+
 int ECUtil::decode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
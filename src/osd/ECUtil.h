@@ -77,8 +77,44 @@ public:
       (in.first - off) + in.second);
     return std::make_pair(off, len);
   }
+  unsigned get_data_chunk_count() const {
+    return stripe_width / chunk_size;
+  }
+  /// offset and length within data chunk @chunk holding the logical
+  /// range @in, (0, 0) if the range does not touch that chunk
+  std::pair<uint64_t, uint64_t> offset_len_to_chunk_range(
+    std::pair<uint64_t, uint64_t> in, unsigned chunk) const;
+  /// data chunks holding any part of the logical range @in
+  void offset_len_to_data_chunks(
+    std::pair<uint64_t, uint64_t> in, std::set<int> *chunks) const;
+  /// offset and length within each coding chunk of the parity of the
+  /// logical range @in: the union of its data chunk ranges
+  std::pair<uint64_t, uint64_t> offset_len_to_parity_range(
+    std::pair<uint64_t, uint64_t> in) const;
 };
 
+/**
+ * rebuild the logical range @offset~@len from the data chunk ranges
+ * returned by offset_len_to_chunk_range, keyed by data chunk index
+ *
+ * Stops at the first chunk range which was read short.
+ */
+void assemble(
+  const stripe_info_t &sinfo,
+  uint64_t offset,
+  uint64_t len,
+  std::map<int, ceph::buffer::list> &chunks,
+  ceph::buffer::list *out);
+
+/// inverse of assemble: split the logical range @offset~@len held in
+/// @in into its data chunk ranges, keyed by data chunk index
+void split(
+  const stripe_info_t &sinfo,
+  uint64_t offset,
+  uint64_t len,
+  const ceph::buffer::list &in,
+  std::map<int, ceph::buffer::list> *chunks);
+
 int decode(
   const stripe_info_t &sinfo,
   ceph::ErasureCodeInterfaceRef &ec_impl,
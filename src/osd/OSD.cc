@@ -1261,6 +1261,55 @@ void OSDService::prune_pg_created()
 // --------------------------------------
 // dispatch
 
+void OSDService::_refill_scrub_budget(double rate)
+{
+  auto now = ceph::mono_clock::now();
+  if (scrub_budget_stamp != ceph::mono_time()) {
+    scrub_budget += rate * std::chrono::duration<double>(
+      now - scrub_budget_stamp).count();
+  }
+  // allow at most a second worth of burst, and of debt, so that one
+  // huge object doesn't stall every scrub on the osd for minutes
+  scrub_budget = std::clamp(scrub_budget, -rate, rate);
+  scrub_budget_stamp = now;
+}
+
+double OSDService::get_scrub_budget_delay()
+{
+  double rate = cct->_conf->osd_deep_scrub_bytes_per_sec;
+  if (rate <= 0) {
+    return -1;
+  }
+  std::lock_guard l(scrub_budget_lock);
+  _refill_scrub_budget(rate);
+  if (scrub_budget >= 0) {
+    return 0;
+  }
+  return -scrub_budget / rate;
+}
+
+int64_t OSDService::get_scrub_budget()
+{
+  double rate = cct->_conf->osd_deep_scrub_bytes_per_sec;
+  if (rate <= 0) {
+    return -1;
+  }
+  std::lock_guard l(scrub_budget_lock);
+  _refill_scrub_budget(rate);
+  return std::max<int64_t>(0, scrub_budget);
+}
+
+void OSDService::charge_scrub_budget(uint64_t bytes)
+{
+  double rate = cct->_conf->osd_deep_scrub_bytes_per_sec;
+  if (rate <= 0 || bytes == 0) {
+    return;
+  }
+  std::lock_guard l(scrub_budget_lock);
+  _refill_scrub_budget(rate);
+  scrub_budget = std::max(scrub_budget - bytes, -rate);
+}
+
 bool OSDService::can_inc_scrubs()
 {
   bool can_inc = false;
@@ -1918,12 +1967,15 @@ void OSDService::_queue_for_recovery(
   uint64_t reserved_pushes)
 {
   ceph_assert(ceph_mutex_is_locked_by_me(recovery_lock));
+  // small objects the PG's last recovery batch pushed beyond its
+  // reservations are paid for here, so they don't escape the scheduler
+  uint64_t objects = 1 + p.second->take_recovery_batched();
   enqueue_back(
     OpSchedulerItem(
       unique_ptr<OpSchedulerItem::OpQueueable>(
 	new PGRecovery(
-	  p.second->get_pgid(), p.first, reserved_pushes)),
-      cct->_conf->osd_recovery_cost,
+	  p.second->get_pgid(), p.first, reserved_pushes, objects)),
+      cct->_conf->osd_recovery_cost * objects,
       cct->_conf->osd_recovery_priority,
       ceph_clock_now(),
       0,
@@ -9565,6 +9617,14 @@ void OSDService::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue)
   _maybe_queue_recovery();
 }
 
+uint64_t OSDService::get_recovery_headroom()
+{
+  std::lock_guard l(recovery_lock);
+  uint64_t available_pushes;
+  _recover_now(&available_pushes);
+  return available_pushes;
+}
+
 bool OSDService::is_recovery_active()
 {
   if (cct->_conf->osd_debug_pretend_recovery_active) {
@@ -10158,13 +10218,13 @@ void OSDShard::_wake_pg_slot(
   for (auto i = slot->to_process.rbegin();
        i != slot->to_process.rend();
        ++i) {
-    scheduler->enqueue_front(std::move(*i));
+    _enqueue_front(std::move(*i));
   }
   slot->to_process.clear();
   for (auto i = slot->waiting.rbegin();
        i != slot->waiting.rend();
        ++i) {
-    scheduler->enqueue_front(std::move(*i));
+    _enqueue_front(std::move(*i));
   }
   slot->waiting.clear();
   for (auto i = slot->waiting_peering.rbegin();
@@ -10174,13 +10234,36 @@ void OSDShard::_wake_pg_slot(
     // items are waiting for maps we don't have yet.  FIXME, maybe,
     // someday, if we decide this inefficiency matters
     for (auto j = i->second.rbegin(); j != i->second.rend(); ++j) {
-      scheduler->enqueue_front(std::move(*j));
+      _enqueue_front(std::move(*j));
     }
   }
   slot->waiting_peering.clear();
   ++slot->requeue_seq;
 }
 
+void OSDShard::_enqueue(OpSchedulerItem&& item)
+{
+  ++scheduled_pgs[item.get_ordering_token()];
+  scheduler->enqueue(std::move(item));
+}
+
+void OSDShard::_enqueue_front(OpSchedulerItem&& item)
+{
+  ++scheduled_pgs[item.get_ordering_token()];
+  scheduler->enqueue_front(std::move(item));
+}
+
+OpSchedulerItem OSDShard::_dequeue()
+{
+  OpSchedulerItem item = scheduler->dequeue();
+  auto p = scheduled_pgs.find(item.get_ordering_token());
+  ceph_assert(p != scheduled_pgs.end());
+  if (--p->second == 0) {
+    scheduled_pgs.erase(p);
+  }
+  return item;
+}
+
 void OSDShard::identify_splits_and_merges(
   const OSDMapRef& as_of_osdmap,
   set<pair<spg_t,epoch_t>> *split_pgs,
@@ -10430,6 +10513,18 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 
   // peek at spg_t
   sdata->shard_lock.lock();
+  if (sdata->scheduler->empty() &&
+      (!is_smallest_thread_index || sdata->context_queue.empty()) &&
+      osd->cct->_conf->osd_op_queue_work_stealing &&
+      osd->num_shards > 1 &&
+      !osd->is_stopping()) {
+    // nothing to do here; help a busy shard before going to sleep
+    sdata->shard_lock.unlock();
+    if (_steal(shard_index, hb)) {
+      return;
+    }
+    sdata->shard_lock.lock();
+  }
   if (sdata->scheduler->empty() &&
       (!is_smallest_thread_index || sdata->context_queue.empty())) {
     std::unique_lock wait_lock{sdata->sdata_wait_lock};
@@ -10440,7 +10535,9 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       dout(20) << __func__ << " empty q, waiting" << dendl;
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.unlock();
+      ++sdata->waiting_threads;
       sdata->sdata_cond.wait(wait_lock);
+      --sdata->waiting_threads;
       wait_lock.unlock();
       sdata->shard_lock.lock();
       if (sdata->scheduler->empty() &&
@@ -10478,7 +10575,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
     return;
   }
 
-  OpSchedulerItem item = sdata->scheduler->dequeue();
+  OpSchedulerItem item = sdata->_dequeue();
   if (osd->is_stopping()) {
     sdata->shard_lock.unlock();
     for (auto c : oncommits) {
@@ -10488,6 +10585,87 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
     return;    // OSD shutdown, discard.
   }
 
+  _process_item(sdata, std::move(item), oncommits, hb);
+}
+
+bool OSD::ShardedOpWQ::_steal(uint32_t shard_index, heartbeat_handle_d *hb)
+{
+  for (uint32_t i = 1; i < osd->num_shards; ++i) {
+    auto sdata = osd->shards[(shard_index + i) % osd->num_shards];
+    if (sdata->waiting_threads) {
+      // it has idle threads of its own
+      continue;
+    }
+    if (!sdata->shard_lock.try_lock()) {
+      continue;
+    }
+    if (sdata->scheduled_pgs.size() < 2 || osd->is_stopping()) {
+      // nothing queued, or only a single pg's backlog
+      sdata->shard_lock.unlock();
+      continue;
+    }
+    OpSchedulerItem item = sdata->_dequeue();
+    // prefer items whose pg is idle: a busy pg is serialized on its
+    // lock anyway, and we would just wait for it
+    auto p = sdata->pg_slots.find(item.get_ordering_token());
+    if (p != sdata->pg_slots.end()) {
+      OSDShardPGSlot *slot = p->second.get();
+      bool busy = slot->num_running > 0 || !slot->to_process.empty();
+      if (!busy && slot->pg) {
+	if (slot->pg->try_lock()) {
+	  slot->pg->unlock();
+	} else {
+	  busy = true;
+	}
+      }
+      // put it back through its own class, so that it keeps its qos.
+      // that is only in order if nothing of its pg is queued behind
+      // it; otherwise take it and wait for the pg.
+      if (busy && !sdata->scheduled_pgs.count(item.get_ordering_token())) {
+	dout(20) << __func__ << " shard " << sdata->shard_id
+		 << " " << item << " pg busy, not stealing" << dendl;
+	sdata->_enqueue(std::move(item));
+	sdata->shard_lock.unlock();
+	osd->logger->inc(l_osd_op_wq_steal_busy);
+	continue;
+      }
+    }
+    dout(20) << __func__ << " shard " << shard_index << " stealing " << item
+	     << " from shard " << sdata->shard_id << dendl;
+    osd->logger->inc(l_osd_op_wq_stolen);
+    osd->cct->get_heartbeat_map()->reset_timeout(hb,
+      timeout_interval, suicide_interval);
+    // oncommits stay with the owning shard's first thread, for ordering
+    list<Context *> oncommits;
+    _process_item(sdata, std::move(item), oncommits, hb);
+    return true;
+  }
+  return false;
+}
+
+void OSD::ShardedOpWQ::_wake_thief(uint32_t shard_index)
+{
+  if (osd->shards[shard_index]->waiting_threads) {
+    // it will get to the item itself
+    return;
+  }
+  for (uint32_t i = 1; i < osd->num_shards; ++i) {
+    auto sdata = osd->shards[(shard_index + i) % osd->num_shards];
+    if (sdata->waiting_threads) {
+      std::lock_guard l{sdata->sdata_wait_lock};
+      sdata->sdata_cond.notify_one();
+      return;
+    }
+  }
+}
+
+void OSD::ShardedOpWQ::_process_item(
+  OSDShard *sdata,
+  OpSchedulerItem&& item,
+  list<Context*>& oncommits,
+  heartbeat_handle_d *hb)
+{
+  const uint32_t shard_index = sdata->shard_id; // for dout_prefix
   const auto token = item.get_ordering_token();
   auto r = sdata->pg_slots.emplace(token, nullptr);
   if (r.second) {
@@ -10721,15 +10899,21 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
   assert (NULL != sdata);
 
   bool empty = true;
+  bool backlog = false;
   {
     std::lock_guard l{sdata->shard_lock};
     empty = sdata->scheduler->empty();
-    sdata->scheduler->enqueue(std::move(item));
+    sdata->_enqueue(std::move(item));
+    // a backlog of a single pg is serialized on its lock; a thief
+    // could not help with it
+    backlog = sdata->scheduled_pgs.size() > 1;
   }
 
   if (empty) {
     std::lock_guard l{sdata->sdata_wait_lock};
     sdata->sdata_cond.notify_all();
+  } else if (backlog && osd->cct->_conf->osd_op_queue_work_stealing) {
+    _wake_thief(shard_index);
   }
 }
 
@@ -10755,7 +10939,7 @@ void OSD::ShardedOpWQ::_enqueue_front(OpSchedulerItem&& item)
   } else {
     dout(20) << __func__ << " " << item << dendl;
   }
-  sdata->scheduler->enqueue_front(std::move(item));
+  sdata->_enqueue_front(std::move(item));
   sdata->shard_lock.unlock();
   std::lock_guard l{sdata->sdata_wait_lock};
   sdata->sdata_cond.notify_one();
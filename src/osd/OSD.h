@@ -279,6 +279,13 @@ private:
   int scrubs_local;
   int scrubs_remote;
 
+  // -- deep scrub read budget --
+  ceph::mutex scrub_budget_lock = ceph::make_mutex("OSDService::scrub_budget_lock");
+  ceph::mono_time scrub_budget_stamp;
+  double scrub_budget = 0;  ///< bytes scrub may read now; < 0 if overdrawn
+			    ///< (by at most a second's worth)
+  void _refill_scrub_budget(double rate);
+
 public:
   struct ScrubJob {
     CephContext* cct;
@@ -359,6 +366,12 @@ public:
   void dec_scrubs_remote();
   void dump_scrub_reservations(ceph::Formatter *f);
 
+  /// seconds until scrub may read again, or < 0 if there is no budget
+  double get_scrub_budget_delay();
+  /// bytes scrub may read now, or < 0 if there is no budget
+  int64_t get_scrub_budget();
+  void charge_scrub_budget(uint64_t bytes);
+
   void reply_op_error(OpRequestRef op, int err);
   void reply_op_error(OpRequestRef op, int err, eversion_t v, version_t uv,
 		      std::vector<pg_log_op_return_item_t> op_returns);
@@ -632,6 +645,8 @@ private:
 public:
   void start_recovery_op(PG *pg, const hobject_t& soid);
   void finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue);
+  /// recovery ops that may still start without exceeding osd_recovery_max_active
+  uint64_t get_recovery_headroom();
   bool is_recovery_active();
   void release_reserved_pushes(uint64_t pushes);
   void defer_recovery(float defer_for) {
@@ -1020,8 +1035,14 @@ struct OSDShard {
   /// priority queue
   ceph::osd::scheduler::OpSchedulerRef scheduler;
 
+  /// number of items each pg has queued in scheduler
+  std::unordered_map<spg_t,unsigned> scheduled_pgs;
+
   bool stop_waiting = false;
 
+  /// _process threads asleep on sdata_cond, which may steal work
+  std::atomic<unsigned> waiting_threads = {0};
+
   ContextQueue context_queue;
 
   void _attach_pg(OSDShardPGSlot *slot, PG *pg);
@@ -1041,6 +1062,11 @@ struct OSDShard {
 
   void _wake_pg_slot(spg_t pgid, OSDShardPGSlot *slot);
 
+  /// queue with scheduler, keeping scheduled_pgs up to date
+  void _enqueue(ceph::osd::scheduler::OpSchedulerItem&& item);
+  void _enqueue_front(ceph::osd::scheduler::OpSchedulerItem&& item);
+  ceph::osd::scheduler::OpSchedulerItem _dequeue();
+
   void identify_splits_and_merges(
     const OSDMapRef& as_of_osdmap,
     std::set<std::pair<spg_t,epoch_t>> *split_children,
@@ -1588,6 +1614,19 @@ protected:
     /// try to do some work
     void _process(uint32_t thread_index, ceph::heartbeat_handle_d *hb) override;
 
+    /// process @item, just dequeued from @sdata with shard_lock held
+    void _process_item(
+      OSDShard *sdata,
+      OpSchedulerItem&& item,
+      std::list<Context*>& oncommits,
+      ceph::heartbeat_handle_d *hb);
+
+    /// process an item of another shard whose pg is idle, if any
+    bool _steal(uint32_t shard_index, ceph::heartbeat_handle_d *hb);
+
+    /// wake a sleeping thread of another shard to steal from @shard_index
+    void _wake_thief(uint32_t shard_index);
+
     /// enqueue a new item
     void _enqueue(OpSchedulerItem&& item) override;
 
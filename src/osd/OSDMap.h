@@ -617,6 +617,7 @@ private:
   uint32_t crush_version = 1;
 
   friend class OSDMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
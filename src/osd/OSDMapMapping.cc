@@ -8,6 +8,8 @@
 
 #include "common/debug.h"
 
+using std::set;
+using std::string;
 using std::vector;
 
 MEMPOOL_DEFINE_OBJECT_FACTORY(OSDMapMapping, osdmapmapping,
@@ -32,13 +34,15 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
 	q = pools.erase(q);
       } else {
 	// keep it
+	q->second.set_placement(p.second);
 	++q;
 	continue;
       }
     }
-    pools.emplace(p.first, PoolMapping(p.second.get_size(),
-				       p.second.get_pg_num(),
-				       p.second.is_erasure()));
+    auto r = pools.emplace(p.first, PoolMapping(p.second.get_size(),
+						p.second.get_pg_num(),
+						p.second.is_erasure()));
+    r.first->second.set_placement(p.second);
   }
   pools.erase(q, pools.end());
   ceph_assert(pools.size() == osdmap.get_pools().size());
@@ -46,11 +50,13 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
 
 void OSDMapMapping::update(const OSDMap& osdmap)
 {
+  full_reason = "requested";
   _start(osdmap);
   for (auto& p : osdmap.get_pools()) {
     _update_range(osdmap, p.first, 0, p.second.get_pg_num());
   }
   _finish(osdmap);
+  last_update_pgs = num_pgs;
   //_dump();  // for debugging
 }
 
@@ -59,6 +65,243 @@ void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
 }
 
+void OSDMapMapping::update(const OSDMap& osdmap,
+			   const OSDMap::Incremental& inc)
+{
+  vector<pg_t> pgs;
+  if (!_calc_delta(osdmap, inc, &pgs)) {
+    string reason = std::move(full_reason);
+    update(osdmap);
+    full_reason = std::move(reason);
+    return;
+  }
+  _start(osdmap);
+  for (auto& pgid : pgs) {
+    _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
+  }
+  _finish(osdmap);
+}
+
+std::unique_ptr<OSDMapMapping::MappingJob> OSDMapMapping::start_update(
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  ParallelPGMapper& mapper,
+  unsigned pgs_per_item)
+{
+  vector<pg_t> pgs;
+  if (!_calc_delta(osdmap, inc, &pgs)) {
+    string reason = std::move(full_reason);
+    auto job = start_update(osdmap, mapper, pgs_per_item);
+    full_reason = std::move(reason);
+    return job;
+  }
+  std::unique_ptr<MappingJob> job(new MappingJob(&osdmap, this));
+  if (pgs.empty()) {
+    // nothing moved; no need to bother the workers
+    job->finish = ceph_clock_now();
+    job->complete();
+  } else {
+    mapper.queue(job.get(), pgs_per_item, pgs);
+  }
+  return job;
+}
+
+// Work out which pgs inc can have remapped.  Placement is
+//   crush (rule, weights) -> upmap -> remove down osds -> primary
+//   affinity -> pg_temp/primary_temp
+// so a change to a pg's upmap or temp entries only affects that pg, an
+// osd going down or changing primary affinity only affects the pgs it
+// is currently mapped to, and an osd coming up, being (re)weighted or
+// created/destroyed can affect any pg crush may place on it, plus any
+// pg whose upmap or pg_temp names it.  Anything else that can move pgs
+// (crush itself, pool placement properties) recomputes whole pools or
+// the whole map.
+bool OSDMapMapping::_calc_delta(
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  vector<pg_t> *pgs)
+{
+  full_reason.clear();
+  if (updating) {
+    full_reason = "previous update did not complete";
+  } else if (epoch == 0) {
+    full_reason = "no previous mapping";
+  } else if (epoch + 1 != inc.epoch || osdmap.get_epoch() != inc.epoch) {
+    full_reason = "mapping is e" + std::to_string(epoch) +
+      ", incremental is e" + std::to_string(inc.epoch);
+  } else if (inc.fullmap.length()) {
+    full_reason = "incremental carries a full map";
+  } else if (inc.crush.length()) {
+    full_reason = "crush map changed";
+  } else if (inc.new_max_osd >= 0) {
+    full_reason = "max_osd changed";
+  }
+  if (!full_reason.empty()) {
+    return false;
+  }
+
+  set<int64_t> dirty_pools;
+  set<pg_t> dirty_pgs;
+  set<int> mapped_osds;     // recompute pgs currently mapped to these
+  set<int> placeable_osds;  // recompute pgs crush/upmap/temp may place here
+
+  for (auto& p : osdmap.get_pools()) {
+    auto q = pools.find(p.first);
+    if (q == pools.end() ||
+	q->second.pg_num != p.second.get_pg_num() ||
+	q->second.size != p.second.get_size() ||
+	!q->second.same_placement(p.second)) {
+      dirty_pools.insert(p.first);
+    }
+  }
+
+  for (auto& [osd, state] : inc.new_state) {
+    // a zero state is a legacy encoding of CEPH_OSD_UP
+    unsigned s = state ? state : CEPH_OSD_UP;
+    if (s & CEPH_OSD_EXISTS) {
+      placeable_osds.insert(osd);
+    } else if (s & CEPH_OSD_UP) {
+      if (osdmap.is_up(osd)) {
+	placeable_osds.insert(osd);
+      } else {
+	mapped_osds.insert(osd);
+      }
+    }
+  }
+  for (auto& p : inc.new_up_client) {
+    placeable_osds.insert(p.first);
+  }
+  for (auto& p : inc.new_weight) {
+    placeable_osds.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_affinity) {
+    mapped_osds.insert(p.first);
+  }
+
+  for (auto& p : inc.new_pg_temp) {
+    dirty_pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_temp) {
+    dirty_pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap) {
+    dirty_pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap_items) {
+    dirty_pgs.insert(p.first);
+  }
+  dirty_pgs.insert(inc.old_pg_upmap.begin(), inc.old_pg_upmap.end());
+  dirty_pgs.insert(inc.old_pg_upmap_items.begin(),
+		   inc.old_pg_upmap_items.end());
+
+  if (!placeable_osds.empty()) {
+    auto mentions = [&](auto& osds) {
+      for (auto o : osds) {
+	if (placeable_osds.count(o)) {
+	  return true;
+	}
+      }
+      return false;
+    };
+    for (auto& p : osdmap.pg_upmap) {
+      if (mentions(p.second)) {
+	dirty_pgs.insert(p.first);
+      }
+    }
+    for (auto& p : osdmap.pg_upmap_items) {
+      for (auto& [from, to] : p.second) {
+	if (placeable_osds.count(from) || placeable_osds.count(to)) {
+	  dirty_pgs.insert(p.first);
+	  break;
+	}
+      }
+    }
+    for (auto p = osdmap.pg_temp->begin(); p != osdmap.pg_temp->end(); ++p) {
+      if (mentions(p->second)) {
+	dirty_pgs.insert(p->first);
+      }
+    }
+    for (auto& p : *osdmap.primary_temp) {
+      if (placeable_osds.count(p.second)) {
+	dirty_pgs.insert(p.first);
+      }
+    }
+
+    // pools whose rule can reach any of the osds
+    std::map<int,bool> rule_reaches;
+    for (auto& p : osdmap.get_pools()) {
+      if (dirty_pools.count(p.first)) {
+	continue;
+      }
+      int ruleno = osdmap.crush->find_rule(p.second.get_crush_rule(),
+					   p.second.get_type(),
+					   p.second.get_size());
+      auto r = rule_reaches.find(ruleno);
+      if (r == rule_reaches.end()) {
+	std::map<int,float> weights;
+	bool reaches = true;
+	if (ruleno >= 0 &&
+	    osdmap.crush->get_rule_weight_osd_map(ruleno, &weights) >= 0) {
+	  reaches = false;
+	  for (auto o : placeable_osds) {
+	    if (weights.count(o)) {
+	      reaches = true;
+	      break;
+	    }
+	  }
+	}
+	r = rule_reaches.emplace(ruleno, reaches).first;
+      }
+      if (r->second) {
+	dirty_pools.insert(p.first);
+      }
+    }
+  }
+
+  if (!mapped_osds.empty()) {
+    for (auto& [poolid, pm] : pools) {
+      if (dirty_pools.count(poolid) ||
+	  !osdmap.have_pg_pool(poolid)) {
+	continue;
+      }
+      for (unsigned ps = 0; ps < pm.pg_num; ++ps) {
+	for (auto o : mapped_osds) {
+	  if (pm.maps_to(ps, o)) {
+	    dirty_pgs.insert(pg_t(ps, poolid));
+	    break;
+	  }
+	}
+      }
+    }
+  }
+
+  // collect, skipping pgs that no longer exist or are covered by a pool
+  for (auto poolid : dirty_pools) {
+    unsigned pg_num = osdmap.get_pg_pool(poolid)->get_pg_num();
+    for (unsigned ps = 0; ps < pg_num; ++ps) {
+      pgs->push_back(pg_t(ps, poolid));
+    }
+  }
+  for (auto& pgid : dirty_pgs) {
+    if (!dirty_pools.count(pgid.pool()) && osdmap.pg_exists(pgid)) {
+      pgs->push_back(pgid);
+    }
+  }
+
+  uint64_t total = 0;
+  for (auto& p : osdmap.get_pools()) {
+    total += p.second.get_pg_num();
+  }
+  if (pgs->size() > total / 2) {
+    full_reason = std::to_string(pgs->size()) + " of " +
+      std::to_string(total) + " pgs affected";
+    pgs->clear();
+    return false;
+  }
+  last_update_pgs = pgs->size();
+  return true;
+}
+
 void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 {
   acting_rmap.resize(osdmap.get_max_osd());
@@ -90,6 +333,7 @@ void OSDMapMapping::_finish(const OSDMap& osdmap)
 {
   _build_rmap(osdmap);
   epoch = osdmap.get_epoch();
+  updating = false;
 }
 
 void OSDMapMapping::_dump()
@@ -7,13 +7,13 @@
 
 #include <vector>
 #include <map>
+#include <set>
 
 #include "osd/osd_types.h"
+#include "osd/OSDMap.h"
 #include "common/WorkQueue.h"
 #include "common/Cond.h"
 
-class OSDMap;
-
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
 public:
@@ -180,6 +180,11 @@ private:
     bool erasure = false;
     mempool::osdmap_mapping::vector<int32_t> table;
 
+    // the rest of the pool properties placement depends on
+    int crush_rule = -1;
+    unsigned pgp_num = 0;
+    bool hashpspool = false;
+
     size_t row_size() const {
       return
 	1 + // acting_primary
@@ -197,6 +202,33 @@ private:
 	table(pg_num * row_size()) {
     }
 
+    bool same_placement(const pg_pool_t& pi) const {
+      return crush_rule == pi.get_crush_rule() &&
+	pgp_num == pi.get_pgp_num() &&
+	hashpspool == pi.has_flag(pg_pool_t::FLAG_HASHPSPOOL);
+    }
+    void set_placement(const pg_pool_t& pi) {
+      crush_rule = pi.get_crush_rule();
+      pgp_num = pi.get_pgp_num();
+      hashpspool = pi.has_flag(pg_pool_t::FLAG_HASHPSPOOL);
+    }
+
+    /// true if osd is in the up or acting set of ps
+    bool maps_to(size_t ps, int osd) const {
+      const int32_t *row = &table[row_size() * ps];
+      for (int i = 0; i < row[2]; ++i) {
+	if (row[4 + i] == osd) {
+	  return true;
+	}
+      }
+      for (int i = 0; i < row[3]; ++i) {
+	if (row[4 + size + i] == osd) {
+	  return true;
+	}
+      }
+      return false;
+    }
+
     void get(size_t ps,
 	     std::vector<int> *up,
 	     int *up_primary,
@@ -251,8 +283,15 @@ private:
   //unused: mempool::osdmap_mapping::vector<std::vector<pg_t>> up_rmap;  // osd -> pg
   epoch_t epoch = 0;
   uint64_t num_pgs = 0;
+  bool updating = false;         ///< an update started but did not finish
+  std::string full_reason;       ///< why the last update was not a delta
+  uint64_t last_update_pgs = 0;  ///< pgs recomputed by the last update
 
   void _init_mappings(const OSDMap& osdmap);
+  bool _calc_delta(
+    const OSDMap& osdmap,
+    const OSDMap::Incremental& inc,
+    std::vector<pg_t> *pgs);
   void _update_range(
     const OSDMap& map,
     int64_t pool,
@@ -261,6 +300,7 @@ private:
   void _build_rmap(const OSDMap& osdmap);
 
   void _start(const OSDMap& osdmap) {
+    updating = true;
     _init_mappings(osdmap);
   }
   void _finish(const OSDMap& osdmap);
@@ -275,7 +315,11 @@ private:
       : Job(osdmap), mapping(m) {
       mapping->_start(*osdmap);
     }
-    void process(const std::vector<pg_t>& pgs) override {}
+    void process(const std::vector<pg_t>& pgs) override {
+      for (auto& pgid : pgs) {
+	mapping->_update_range(*osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
+      }
+    }
     void process(int64_t pool, unsigned ps_begin, unsigned ps_end) override {
       mapping->_update_range(*osdmap, pool, ps_begin, ps_end);
     }
@@ -325,15 +369,36 @@ public:
 
   void update(const OSDMap& map);
   void update(const OSDMap& map, pg_t pgid);
+  /**
+   * update a mapping of map's previous epoch, recomputing only the pgs
+   * inc can have moved.  falls back to a full update if the change
+   * can't be narrowed down; see get_full_reason().
+   */
+  void update(const OSDMap& map, const OSDMap::Incremental& inc);
 
   std::unique_ptr<MappingJob> start_update(
     const OSDMap& map,
     ParallelPGMapper& mapper,
     unsigned pgs_per_item) {
+    full_reason = "requested";
     std::unique_ptr<MappingJob> job(new MappingJob(&map, this));
+    last_update_pgs = num_pgs;
     mapper.queue(job.get(), pgs_per_item, {});
     return job;
   }
+  std::unique_ptr<MappingJob> start_update(
+    const OSDMap& map,
+    const OSDMap::Incremental& inc,
+    ParallelPGMapper& mapper,
+    unsigned pgs_per_item);
+
+  /// empty if the last update only recomputed the pgs a delta touched
+  const std::string& get_full_reason() const {
+    return full_reason;
+  }
+  uint64_t get_last_update_pgs() const {
+    return last_update_pgs;
+  }
 
   epoch_t get_epoch() const {
     return epoch;
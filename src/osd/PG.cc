@@ -256,6 +256,17 @@ void PG::lock(bool no_lockdep) const
   dout(30) << "lock" << dendl;
 }
 
+bool PG::try_lock() const
+{
+  if (!_lock.try_lock())
+    return false;
+#ifndef CEPH_DEBUG_MUTEX
+  locked_by = std::this_thread::get_id();
+#endif
+  ceph_assert(!recovery_state.debug_has_dirty_state());
+  return true;
+}
+
 bool PG::is_locked() const
 {
   return ceph_mutex_is_locked(_lock);
@@ -2359,6 +2370,12 @@ int PG::build_scrub_map_chunk(
   // scan objects
   while (!pos.done()) {
     int r = get_pgbackend()->be_scan_list(map, pos);
+    if (pos.bytes_read) {
+      // the range is blocked for writes until the map is done, so we
+      // only charge here; the next chunk waits for the budget instead
+      osd->charge_scrub_budget(pos.bytes_read);
+      pos.bytes_read = 0;
+    }
     if (r == -EINPROGRESS) {
       return r;
     }
@@ -2493,13 +2510,28 @@ void PG::replica_scrub(
 void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
 {
   OSDService *osds = osd;
-  double scrub_sleep = osds->osd->scrub_sleep_time(scrubber.must_scrub);
+  // with a read budget we wait between chunks exactly as long as it
+  // takes to refill, instead of the fixed scrub sleep
+  double budget_delay = osds->get_scrub_budget_delay();
+  double scrub_sleep = budget_delay;
+  if (scrub_sleep < 0) {
+    scrub_sleep = osds->osd->scrub_sleep_time(scrubber.must_scrub);
+  }
+  // a replica reads as much as the primary, so it also waits for the
+  // budget before it starts on a chunk's map
+  bool replica_chunk_start =
+    budget_delay > 0 &&
+    scrubber.state == PG::Scrubber::BUILD_MAP_REPLICA &&
+    scrubber.replica_scrubmap_pos.empty();
   if (scrub_sleep > 0 &&
       (scrubber.state == PG::Scrubber::NEW_CHUNK ||
-       scrubber.state == PG::Scrubber::INACTIVE) &&
-       scrubber.needs_sleep) {
+       scrubber.state == PG::Scrubber::INACTIVE ||
+       replica_chunk_start) &&
+      scrubber.needs_sleep) {
     ceph_assert(!scrubber.sleeping);
-    dout(20) << __func__ << " state is INACTIVE|NEW_CHUNK, sleeping" << dendl;
+    dout(20) << __func__ << " state is "
+	     << PG::Scrubber::state_string(scrubber.state)
+	     << ", sleeping " << scrub_sleep << dendl;
 
     // Do an async sleep so we don't block the op queue
     spg_t pgid = get_pgid();
@@ -2734,6 +2766,17 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 				      scrubber.preempt_divisor);
 	  int max = std::max<int64_t>(min, cct->_conf->osd_scrub_chunk_max /
                                       scrubber.preempt_divisor);
+	  if (scrubber.deep) {
+	    // take no more objects than the read budget covers right now,
+	    // going by the PG's average object size
+	    const auto& sum = info.stats.stats.sum;
+	    int64_t budget = osd->get_scrub_budget();
+	    if (budget >= 0 && sum.num_objects > 0) {
+	      int64_t obj_bytes = std::max<int64_t>(
+		1, (sum.num_bytes + sum.num_omap_bytes) / sum.num_objects);
+	      max = std::clamp<int64_t>(budget / obj_bytes, min, max);
+	    }
+	  }
           hobject_t start = scrubber.start;
 	  hobject_t candidate_end;
 	  vector<hobject_t> objects;
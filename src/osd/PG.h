@@ -210,6 +210,7 @@ public:
     handle.reset_tp_timeout();
   }
   void lock(bool no_lockdep = false) const;
+  bool try_lock() const;
   void unlock() const;
   bool is_locked() const;
 
@@ -663,8 +664,15 @@ protected:
 #ifdef DEBUG_RECOVERY_OIDS
   multiset<hobject_t> recovering_oids;
 #endif
+  // objects recovery batches started without a reservation of their own
+  std::atomic<uint64_t> recovery_batched = 0;
 
 public:
+  /// objects to charge the PG's next PGRecovery item for, on top of its own
+  uint64_t take_recovery_batched() {
+    return recovery_batched.exchange(0);
+  }
+
   bool dne() { return info.dne(); }
 
   virtual void send_cluster_message(
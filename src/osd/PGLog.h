@@ -21,6 +21,7 @@
 #include "include/common_fwd.h"
 #include "osd_types.h"
 #include "os/ObjectStore.h"
+#include <algorithm>
 #include <list>
 
 #ifdef WITH_SEASTAR
@@ -38,6 +39,192 @@ constexpr auto PGLOG_INDEXED_ALL              = PGLOG_INDEXED_OBJECTS
                                               | PGLOG_INDEXED_EXTRA_CALLER_OPS 
                                               | PGLOG_INDEXED_DUPS;
 
+/**
+ * PGLogDupIndex - index of the pg log dups by reqid.
+ *
+ * There are usually thousands of dups per pg and almost every lookup
+ * (one per incoming write) is a miss, so rather than a hash map node
+ * per entry we keep a flat array of (reqid hash, dup) sorted by hash
+ * plus a small bloom filter in front of it.  Entries added since the
+ * last sort go to an unsorted tail and erased entries are cleared in
+ * place; both are folded back in by rebuild() once they grow past a
+ * fraction of the array, which keeps insert and erase amortized O(1)
+ * for the append-at-head/trim-at-tail pattern of the log.
+ */
+class PGLogDupIndex {
+  struct item_t {
+    uint64_t hash;
+    pg_log_dup_t *dup;   // nullptr once erased
+  };
+  static constexpr size_t MIN_FILTER_BITS = 1024;
+  static constexpr size_t FILTER_BITS_PER_ITEM = 16;
+  static constexpr size_t MIN_SLACK = 32;
+
+  mempool::osd_pglog::vector<item_t> items;  // [0, sorted) sorted by hash
+  size_t sorted = 0;
+  size_t live = 0;
+  mempool::osd_pglog::vector<uint64_t> filter;
+
+  static uint64_t hash_reqid(const osd_reqid_t &r) {
+    // std::hash<osd_reqid_t> just xors the fields together; mix them so
+    // that both the sort and the filter probes see well spread keys
+    uint64_t h = r.name.num() * 0x9e3779b97f4a7c15ull;
+    h ^= r.tid + 0x632be59bd9b4e019ull + (h << 6) + (h >> 2);
+    h ^= ((uint64_t)r.inc << 8 | r.name.type()) + (h << 6) + (h >> 2);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  template <typename F>
+  void for_each_probe(uint64_t h, F&& f) const {
+    const uint64_t mask = filter.size() * 64 - 1;
+    const uint64_t step = (h >> 32) | 1;
+    for (unsigned i = 0; i < 3; ++i, h += step) {
+      f(h & mask);
+    }
+  }
+  void filter_add(uint64_t h) {
+    for_each_probe(h, [this](uint64_t bit) {
+      filter[bit >> 6] |= 1ull << (bit & 63);
+    });
+  }
+  bool filter_test(uint64_t h) const {
+    bool hit = true;
+    for_each_probe(h, [this, &hit](uint64_t bit) {
+      hit = hit && (filter[bit >> 6] & (1ull << (bit & 63)));
+    });
+    return hit;
+  }
+  void rebuild_filter() {
+    size_t bits = MIN_FILTER_BITS;
+    while (bits < live * FILTER_BITS_PER_ITEM) {
+      bits <<= 1;
+    }
+    filter.assign(bits / 64, 0);
+    for (auto& i : items) {
+      if (i.dup) {
+	filter_add(i.hash);
+      }
+    }
+  }
+  void rebuild() {
+    items.erase(std::remove_if(items.begin(), items.end(),
+			       [](const item_t& i) { return !i.dup; }),
+		items.end());
+    std::sort(items.begin(), items.end(),
+	      [](const item_t& a, const item_t& b) { return a.hash < b.hash; });
+    sorted = items.size();
+    if (items.capacity() > 2 * items.size() + MIN_SLACK) {
+      items.shrink_to_fit();
+    }
+    rebuild_filter();
+  }
+  size_t slack() const {
+    return std::max(MIN_SLACK, sorted / 8);
+  }
+
+  /// call f(item) on every entry with the given hash, dead or alive
+  template <typename F>
+  void for_each_match(uint64_t h, F&& f) const {
+    auto p = std::lower_bound(
+      items.begin(), items.begin() + sorted, h,
+      [](const item_t& i, uint64_t h) { return i.hash < h; });
+    for (; p != items.begin() + sorted && p->hash == h; ++p) {
+      f(*p);
+    }
+    for (auto q = items.begin() + sorted; q != items.end(); ++q) {
+      if (q->hash == h) {
+	f(*q);
+      }
+    }
+  }
+
+public:
+  PGLogDupIndex() {
+    filter.assign(MIN_FILTER_BITS / 64, 0);
+  }
+
+  size_t size() const {
+    return live;
+  }
+  bool empty() const {
+    return live == 0;
+  }
+  void clear() {
+    items.clear();
+    sorted = live = 0;
+    filter.assign(MIN_FILTER_BITS / 64, 0);
+  }
+
+  void insert(pg_log_dup_t *dup) {
+    items.push_back(item_t{hash_reqid(dup->reqid), dup});
+    ++live;
+    if (items.size() - sorted > slack()) {
+      rebuild();
+    } else if (live * FILTER_BITS_PER_ITEM > filter.size() * 64) {
+      rebuild_filter();
+    } else {
+      filter_add(items.back().hash);
+    }
+  }
+
+  void erase(const pg_log_dup_t &dup) {
+    const uint64_t h = hash_reqid(dup.reqid);
+    if (!filter_test(h)) {
+      return;
+    }
+    for_each_match(h, [&](const item_t& i) {
+      if (i.dup == &dup) {
+	const_cast<item_t&>(i).dup = nullptr;
+	--live;
+      }
+    });
+    if (items.size() - live > slack()) {
+      // the bloom filter cannot forget, so shrink it along with the array
+      rebuild();
+    }
+  }
+
+  /// newest dup for reqid r, or nullptr
+  pg_log_dup_t *find(const osd_reqid_t &r) const {
+    const uint64_t h = hash_reqid(r);
+    if (!filter_test(h)) {
+      return nullptr;
+    }
+    pg_log_dup_t *found = nullptr;
+    for_each_match(h, [&](const item_t& i) {
+      if (i.dup && i.dup->reqid == r &&
+	  (!found || found->version < i.dup->version)) {
+	found = i.dup;
+      }
+    });
+    return found;
+  }
+  size_t count(const osd_reqid_t &r) const {
+    return find(r) ? 1 : 0;
+  }
+
+  template <typename C>
+  void build(C& dups) {
+    clear();
+    items.reserve(dups.size());
+    for (auto& d : dups) {
+      items.push_back(item_t{hash_reqid(d.reqid), const_cast<pg_log_dup_t*>(&d)});
+    }
+    live = items.size();
+    rebuild();
+  }
+
+  size_t get_bytes() const {
+    return items.capacity() * sizeof(item_t) +
+      filter.capacity() * sizeof(uint64_t);
+  }
+};
+
 struct PGLog : DoutPrefixProvider {
   std::ostream& gen_prefix(std::ostream& out) const override {
     return out;
@@ -75,7 +262,7 @@ public:
     mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
     mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
     mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
+    mutable PGLogDupIndex dup_index;
 
     // recovery pointers
     std::list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -315,12 +502,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_DUPS)) {
         index_dups();
       }
-      auto q = dup_index.find(r);
-      if (q != dup_index.end()) {
-	*version = q->second->version;
-	*user_version = q->second->user_version;
-	*return_code = q->second->return_code;
-	*op_returns = q->second->op_returns;
+      if (auto q = dup_index.find(r); q) {
+	*version = q->version;
+	*user_version = q->user_version;
+	*return_code = q->return_code;
+	*op_returns = q->op_returns;
 	return true;
       }
 
@@ -383,10 +569,7 @@ public:
       if (to_index & PGLOG_INDEXED_EXTRA_CALLER_OPS)
 	extra_caller_ops.clear();
       if (to_index & PGLOG_INDEXED_DUPS) {
-	dup_index.clear();
-	for (auto& i : dups) {
-	  dup_index[i.reqid] = const_cast<pg_log_dup_t*>(&i);
-	}
+	dup_index.build(dups);
       }
 
       constexpr __u16 any_log_entry_index =
@@ -500,16 +683,13 @@ public:
 
     void index(pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	dup_index[e.reqid] = &e;
+	dup_index.insert(&e);
       }
     }
 
     void unindex(const pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	auto i = dup_index.find(e.reqid);
-	if (i != dup_index.end()) {
-	  dup_index.erase(i);
-	}
+	dup_index.erase(e);
       }
     }
 
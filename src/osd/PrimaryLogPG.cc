@@ -12813,6 +12813,7 @@ uint64_t PrimaryLogPG::recover_replicas(uint64_t max, ThreadPool::TPHandle &hand
 {
   dout(10) << __func__ << "(" << max << ")" << dendl;
   uint64_t started = 0;
+  RecoveryBatch batch(cct, osd);
 
   PGBackend::RecoveryHandle *h = pgbackend->open_recovery_op();
 
@@ -12862,7 +12863,7 @@ uint64_t PrimaryLogPG::recover_replicas(uint64_t max, ThreadPool::TPHandle &hand
     // oldest first!
     const pg_missing_t &m(pm->second);
     for (map<version_t, hobject_t>::const_iterator p = m.get_rmissing().begin();
-	 p != m.get_rmissing().end() && started < max;
+	 p != m.get_rmissing().end() && (started < max || batch.is_open());
 	   ++p) {
       handle.reset_tp_timeout();
       const hobject_t soid(p->second);
@@ -12890,6 +12891,8 @@ uint64_t PrimaryLogPG::recover_replicas(uint64_t max, ThreadPool::TPHandle &hand
       }
 
       if (recovery_state.get_missing_loc().is_deleted(soid)) {
+	if (started >= max)
+	  break;
 	dout(10) << __func__ << ": " << soid << " is a delete, removing" << dendl;
 	map<hobject_t,pg_missing_item>::const_iterator r = m.get_items().find(soid);
 	started += prep_object_replica_deletes(soid, r->second.need, h, work_started);
@@ -12909,12 +12912,24 @@ uint64_t PrimaryLogPG::recover_replicas(uint64_t max, ThreadPool::TPHandle &hand
 	continue;
       }
 
+      // only small objects may join the open batch, and once the
+      // reservations are spent nothing else may start
+      const bool free = batch.is_open() && !soid.is_snap() &&
+	batch.is_free(get_object_context(soid, false));
+      if (started >= max && !free)
+	break;
+
       dout(10) << __func__ << ": recover_object_replicas(" << soid << ")" << dendl;
       map<hobject_t,pg_missing_item>::const_iterator r = m.get_items().find(soid);
-      started += prep_object_replica_pushes(soid, r->second.need, h, work_started);
+      if (prep_object_replica_pushes(soid, r->second.need, h, work_started)) {
+	auto rec = recovering.find(soid);
+	started += batch.charge(
+	  rec != recovering.end() ? rec->second : ObjectContextRef(), free);
+      }
     }
   }
 
+  recovery_batched += batch.get_unreserved();
   pgbackend->run_recovery_op(h, get_recovery_op_priority());
   return started;
 }
@@ -13033,8 +13048,9 @@ uint64_t PrimaryLogPG::recover_backfill(
   }
   backfill_info.trim_to(last_backfill_started);
 
+  RecoveryBatch batch(cct, osd);
   PGBackend::RecoveryHandle *h = pgbackend->open_recovery_op();
-  while (ops < max) {
+  while (ops < max || batch.is_open()) {
     if (backfill_info.begin <= earliest_peer_backfill() &&
 	!backfill_info.extends_to_end() && backfill_info.empty()) {
       hobject_t next = backfill_info.end;
@@ -13046,6 +13062,17 @@ uint64_t PrimaryLogPG::recover_backfill(
 
     dout(20) << "   my backfill interval " << backfill_info << dendl;
 
+    if (ops >= max &&
+	std::any_of(get_backfill_targets().begin(), get_backfill_targets().end(),
+		    [this](const pg_shard_t& bt) {
+		      const BackfillInterval& pbi = peer_backfill_info[bt];
+		      return pbi.begin <= backfill_info.begin &&
+			!pbi.extends_to_end() && pbi.empty();
+		    })) {
+      // a peer scan needs a reservation of its own
+      break;
+    }
+
     bool sent_scan = false;
     for (set<pg_shard_t>::const_iterator i = get_backfill_targets().begin();
 	 i != get_backfill_targets().end();
@@ -13156,6 +13183,11 @@ uint64_t PrimaryLogPG::recover_backfill(
       if (!need_ver_targs.empty() || !missing_targs.empty()) {
 	ObjectContextRef obc = get_object_context(backfill_info.begin, false);
 	ceph_assert(obc);
+	const bool free = batch.is_free(obc);
+	if (ops >= max && !free) {
+	  dout(20) << " BACKFILL batch full at " << backfill_info.begin << dendl;
+	  break;
+	}
 	if (obc->get_recovery_read()) {
 	  if (!need_ver_targs.empty()) {
 	    dout(20) << " BACKFILL replacing " << check
@@ -13177,7 +13209,7 @@ uint64_t PrimaryLogPG::recover_backfill(
 	    dout(0) << __func__ << " Error " << r << " trying to backfill " << backfill_info.begin << dendl;
 	    break;
 	  }
-	  ops++;
+	  ops += batch.charge(obc, free);
 	} else {
 	  *work_started = true;
 	  dout(20) << "backfill blocking on " << backfill_info.begin
@@ -13243,6 +13275,7 @@ uint64_t PrimaryLogPG::recover_backfill(
 				  get_osdmap_epoch());
   }
 
+  recovery_batched += batch.get_unreserved();
   pgbackend->run_recovery_op(h, get_recovery_op_priority());
 
   dout(5) << "backfill_pos is " << backfill_pos << dendl;
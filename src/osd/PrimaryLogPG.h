@@ -1306,6 +1306,62 @@ protected:
     uint64_t max,
     ThreadPool::TPHandle &handle, uint64_t *started) override;
 
+  /**
+   * RecoveryBatch
+   *
+   * A reserved recovery op normally covers a single object.  Objects no
+   * larger than osd_recovery_small_object_size are instead grouped, up to
+   * osd_recovery_batch_small_objects of them per reservation, so that they
+   * share one recovery handle and their pushes go out in common
+   * MOSDPGPush messages.  Objects are still started in the usual order.
+   *
+   * Objects that ride along without a reservation still count against
+   * osd_recovery_max_active, and are charged to the PG's next recovery
+   * item in the op scheduler (see PG::take_recovery_batched).
+   */
+  class RecoveryBatch {
+    OSDService *osd;
+    const uint64_t max_objects;
+    const uint64_t small_size;
+    uint64_t in_batch = 0;
+    uint64_t unreserved = 0;
+  public:
+    RecoveryBatch(CephContext *cct, OSDService *osd)
+      : osd(osd),
+	max_objects(cct->_conf->osd_recovery_batch_small_objects),
+	small_size(cct->_conf->osd_recovery_small_object_size) {}
+
+    bool is_small(const ObjectContextRef& obc) const {
+      // omap is pushed in full whatever the object size
+      return max_objects > 1 && obc && obc->obs.oi.size <= small_size &&
+	!obc->obs.oi.is_omap();
+    }
+    /// true if there is room for more small objects without a new reservation
+    bool is_open() const {
+      return in_batch > 0 && in_batch < max_objects;
+    }
+    /// true if obc could be started without consuming a reservation
+    bool is_free(const ObjectContextRef& obc) const {
+      return is_open() && is_small(obc) &&
+	osd->get_recovery_headroom() > 0;
+    }
+    /// account for a started object, returning the reservations it used;
+    /// free must be what is_free() returned before the object was started
+    uint64_t charge(const ObjectContextRef& obc, bool free) {
+      if (free) {
+	++in_batch;
+	++unreserved;
+	return 0;
+      }
+      in_batch = is_small(obc) ? 1 : 0;
+      return 1;
+    }
+    /// objects started without a reservation of their own
+    uint64_t get_unreserved() const {
+      return unreserved;
+    }
+  };
+
   uint64_t recover_primary(uint64_t max, ThreadPool::TPHandle &handle);
   uint64_t recover_replicas(uint64_t max, ThreadPool::TPHandle &handle,
 		            bool *recovery_started);
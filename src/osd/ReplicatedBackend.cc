@@ -646,6 +646,39 @@ int ReplicatedBackend::be_deep_scrub(
   }
 
   ceph_assert(poid == pos.ls[pos.pos]);
+  if (!pos.data_done() && pos.data_pos == 0) {
+    pos.csum_only = cct->_conf->osd_deep_scrub_verify_store_csum;
+  }
+  if (!pos.data_done() && pos.csum_only) {
+    r = store->verify_data(
+      ch,
+      ghobject_t(
+	poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
+      pos.data_pos,
+      cct->_conf->osd_deep_scrub_stride,
+      fadvise_flags);
+    if (r == -EOPNOTSUPP) {
+      dout(20) << __func__ << "  " << poid << " store can't verify csums,"
+	       << " reading data" << dendl;
+      pos.csum_only = false;
+      pos.data_pos = 0;
+    } else if (r < 0) {
+      dout(20) << __func__ << "  " << poid << " got "
+	       << r << " on verify, read_error" << dendl;
+      o.read_error = true;
+      return 0;
+    } else {
+      pos.bytes_read += r;
+      pos.data_pos += r;
+      if (r == cct->_conf->osd_deep_scrub_stride) {
+	return -EINPROGRESS;
+      }
+      // done with bytes; there is no digest to compare
+      pos.data_pos = -1;
+      dout(20) << __func__ << "  " << poid << " done with data, csums ok"
+	       << dendl;
+    }
+  }
   if (!pos.data_done()) {
     if (pos.data_pos == 0) {
       pos.data_hash = bufferhash(-1);
@@ -667,6 +700,7 @@ int ReplicatedBackend::be_deep_scrub(
     }
     if (r > 0) {
       pos.data_hash << bl;
+      pos.bytes_read += r;
     }
     pos.data_pos += r;
     if (r == cct->_conf->osd_deep_scrub_stride) {
@@ -699,6 +733,7 @@ int ReplicatedBackend::be_deep_scrub(
       return 0;
     }
     if (r == 0 && hdrbl.length()) {
+      pos.bytes_read += hdrbl.length();
       bool encoded = false;
       dout(25) << "CRC header " << cleanbin(hdrbl, encoded, true) << dendl;
       pos.omap_hash << hdrbl;
@@ -726,6 +761,7 @@ int ReplicatedBackend::be_deep_scrub(
     encode(iter->key(), bl);
     encode(iter->value(), bl);
     pos.omap_hash << bl;
+    pos.bytes_read += bl.length();
 
     iter->next();
 
@@ -278,6 +278,13 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_stolen, "op_wq_stolen",
+    "Op queue items processed by a thread of another shard");
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_steal_busy, "op_wq_steal_busy",
+    "Op queue items left to their shard because their PG was busy");
+
   return osd_plb.create_perf_counters();
 }
  
@@ -118,6 +118,9 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_op_wq_stolen,
+  l_osd_op_wq_steal_busy,
+
   l_osd_last,
 };
 
@@ -5843,6 +5843,8 @@ struct ScrubMapBuilder {
   ceph::buffer::hash data_hash, omap_hash;  ///< accumulatinng hash value
   uint64_t omap_keys = 0;
   uint64_t omap_bytes = 0;
+  uint64_t bytes_read = 0;  ///< not yet charged to the scrub read budget
+  bool csum_only = false;   ///< object store verifies data, no digest
 
   bool empty() {
     return ls.empty();
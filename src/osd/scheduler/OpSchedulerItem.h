@@ -75,6 +75,11 @@ public:
       return 0;
     }
 
+    /// cost charged to the item's class by the mclock scheduler
+    virtual uint32_t get_qos_cost() const {
+      return 1;
+    }
+
     virtual bool is_peering() const {
       return false;
     }
@@ -144,6 +149,9 @@ public:
   uint64_t get_reserved_pushes() const {
     return qitem->get_reserved_pushes();
   }
+  uint32_t get_qos_cost() const {
+    return qitem->get_qos_cost();
+  }
   void run(OSD *osd, OSDShard *sdata,PGRef& pg, ThreadPool::TPHandle &handle) {
     qitem->run(osd, sdata, pg, handle);
   }
@@ -328,14 +336,17 @@ public:
 class PGRecovery : public PGOpQueueable {
   epoch_t epoch_queued;
   uint64_t reserved_pushes;
+  uint32_t objects;  ///< objects charged, including earlier batches'
 public:
   PGRecovery(
     spg_t pg,
     epoch_t epoch_queued,
-    uint64_t reserved_pushes)
+    uint64_t reserved_pushes,
+    uint32_t objects = 1)
     : PGOpQueueable(pg),
       epoch_queued(epoch_queued),
-      reserved_pushes(reserved_pushes) {}
+      reserved_pushes(reserved_pushes),
+      objects(objects) {}
   op_type_t get_op_type() const final {
     return op_type_t::bg_recovery;
   }
@@ -348,6 +359,9 @@ public:
   uint64_t get_reserved_pushes() const final {
     return reserved_pushes;
   }
+  uint32_t get_qos_cost() const final {
+    return objects;
+  }
   void run(
     OSD *osd, OSDShard *sdata, PGRef& pg, ThreadPool::TPHandle &handle) final;
   op_scheduler_class get_scheduler_class() const final {
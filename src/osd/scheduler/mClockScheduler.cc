@@ -94,7 +94,7 @@ void mClockScheduler::enqueue(OpSchedulerItem&& item)
 {
   auto id = get_scheduler_id(item);
   // TODO: express cost, mclock params in terms of per-node capacity?
-  auto cost = 1; //std::max(item.get_cost(), 1);
+  auto cost = item.get_qos_cost(); //std::max(item.get_cost(), 1);
 
   // TODO: move this check into OpSchedulerItem, handle backwards compat
   if (op_scheduler_class::immediate == item.get_scheduler_class()) {
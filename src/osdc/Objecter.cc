@@ -13,6 +13,7 @@
  */
 
 #include <cerrno>
+#include <cmath>
 
 #include "Objecter.h"
 #include "osd/OSDMap.h"
@@ -161,6 +162,9 @@ enum {
   l_osdc_osdop_omap_rd,
   l_osdc_osdop_omap_del,
 
+  l_osdc_replica_read_sent,
+  l_osdc_replica_read_bounced,
+
   l_osdc_last,
 };
 
@@ -379,6 +383,11 @@ void Objecter::init()
     pcb.add_u64_counter(l_osdc_osdop_omap_del, "omap_del",
 			"OSD OMAP delete operations");
 
+    pcb.add_u64_counter(l_osdc_replica_read_sent, "replica_read_sent",
+			"Balanced or localized reads sent to a replica");
+    pcb.add_u64_counter(l_osdc_replica_read_bounced, "replica_read_bounced",
+			"Replica reads bounced back to the primary");
+
     logger = pcb.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
   }
@@ -2933,16 +2942,28 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
       int osd;
       bool read = is_read && !is_write;
       if (read && (t->flags & CEPH_OSD_FLAG_BALANCE_READS)) {
-	int p = rand() % acting.size();
+	// any replica will do, but pass over the slow ones
+	vector<uint64_t> latencies;
+	uint64_t slow = _get_read_latencies(acting, &latencies);
+	vector<int> ranks;
+	for (unsigned i = 0; i < acting.size(); ++i) {
+	  if (latencies[i] <= slow)
+	    ranks.push_back(i);
+	}
+	ceph_assert(!ranks.empty());
+	int p = ranks[rand() % ranks.size()];
 	if (p)
 	  t->used_replica = true;
 	osd = acting[p];
 	ldout(cct, 10) << " chose random osd." << osd << " of " << acting
-		       << dendl;
+		       << " read latencies " << latencies << dendl;
       } else if (read && (t->flags & CEPH_OSD_FLAG_LOCALIZE_READS) &&
 		 acting.size() > 1) {
-	// look for a local replica.  prefer the primary if the
-	// distance is the same.
+	// look for a local replica.  among replicas at the same
+	// distance prefer the one serving reads fastest, then the
+	// primary.  replicas much slower than the fastest are skipped.
+	vector<uint64_t> latencies;
+	uint64_t slow = _get_read_latencies(acting, &latencies);
 	int best = -1;
 	int best_locality = 0;
 	for (unsigned i = 0; i < acting.size(); ++i) {
@@ -2950,18 +2971,22 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
 		 cct, acting[i], crush_location);
 	  ldout(cct, 20) << __func__ << " localize: rank " << i
 			 << " osd." << acting[i]
-			 << " locality " << locality << dendl;
-	  if (i == 0 ||
+			 << " locality " << locality
+			 << " read latency " << latencies[i] << dendl;
+	  if (latencies[i] > slow)
+	    continue;
+	  if (best < 0 ||
 	      (locality >= 0 && best_locality >= 0 &&
 	       locality < best_locality) ||
-	      (best_locality < 0 && locality >= 0)) {
+	      (best_locality < 0 && locality >= 0) ||
+	      (locality == best_locality && latencies[i] < latencies[best])) {
 	    best = i;
 	    best_locality = locality;
-	    if (i)
-	      t->used_replica = true;
 	  }
 	}
 	ceph_assert(best >= 0);
+	if (best)
+	  t->used_replica = true;
 	osd = acting[best];
       } else {
 	osd = acting_primary;
@@ -3175,6 +3200,9 @@ MOSDOp *Objecter::_prepare_osd_op(Op *op)
 
   op->target.paused = false;
   op->stamp = ceph::coarse_mono_clock::now();
+  if ((flags & CEPH_OSD_FLAG_READ) && !(flags & CEPH_OSD_FLAG_WRITE)) {
+    op->read_stamp = ceph::mono_clock::now();
+  }
 
   hobject_t hobj = op->target.get_hobj();
   MOSDOp *m = new MOSDOp(client_inc, op->tid,
@@ -3204,6 +3232,8 @@ MOSDOp *Objecter::_prepare_osd_op(Op *op)
   }
 
   logger->inc(l_osdc_op_send);
+  if (op->target.used_replica)
+    logger->inc(l_osdc_replica_read_sent);
   ssize_t sum = 0;
   for (unsigned i = 0; i < m->ops.size(); i++) {
     sum += m->ops[i].indata.length();
@@ -3441,6 +3471,8 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
 
   if (rc == -EAGAIN) {
     ldout(cct, 7) << " got -EAGAIN, resubmitting" << dendl;
+    if (op->target.used_replica)
+      logger->inc(l_osdc_replica_read_bounced);
     if (op->onfinish)
       num_in_flight--;
     _session_op_remove(s, op);
@@ -3455,6 +3487,11 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
     return;
   }
 
+  if ((op->target.flags & CEPH_OSD_FLAG_READ) &&
+      !(op->target.flags & CEPH_OSD_FLAG_WRITE)) {
+    s->note_read_latency(ceph::mono_clock::now() - op->read_stamp);
+  }
+
   sul.unlock();
 
   if (op->objver)
@@ -4962,6 +4999,80 @@ Objecter::OSDSession::~OSDSession()
   ceph_assert(command_ops.empty());
 }
 
+void Objecter::OSDSession::note_read_latency(ceph::timespan lat)
+{
+  // exponentially weighted, a racing update just loses a sample
+  uint64_t sample = std::max<int64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(lat).count(), 1);
+  uint64_t prev = read_latency.load(std::memory_order_relaxed);
+  read_latency.store(prev ? prev - prev / 8 + sample / 8 : sample,
+		     std::memory_order_relaxed);
+  read_latency_stamp.store(
+    ceph::mono_clock::now().time_since_epoch().count(),
+    std::memory_order_relaxed);
+}
+
+/**
+ * fill @latencies with the smoothed read latency of each osd in
+ * @acting, 0 when unknown, and return the latency above which an
+ * osd is too slow to be picked for a balanced or localized read
+ */
+uint64_t Objecter::_get_read_latencies(const vector<int> &acting,
+				       vector<uint64_t> *latencies)
+{
+  double factor = cct->_conf.get_val<double>(
+    "objecter_replica_read_latency_factor");
+  auto half_life = cct->_conf.get_val<std::chrono::seconds>(
+    "objecter_replica_read_latency_half_life");
+  auto now = ceph::mono_clock::now().time_since_epoch().count();
+  vector<pair<uint64_t, ceph::timespan>> samples;
+  for (auto osd : acting) {
+    uint64_t l = 0;
+    uint64_t stamp = now;
+    auto p = osd_sessions.find(osd);
+    if (p != osd_sessions.end()) {
+      l = p->second->read_latency.load(std::memory_order_relaxed);
+      stamp = p->second->read_latency_stamp.load(std::memory_order_relaxed);
+    }
+    samples.emplace_back(
+      l, std::chrono::nanoseconds(now > stamp ? now - stamp : 0));
+  }
+  return calc_read_latencies(samples, factor, half_life, latencies);
+}
+
+/**
+ * given the smoothed read latency of each osd and the time since it
+ * was last sampled, fill @latencies with the latency to judge each osd
+ * by, and return the latency above which an osd is too slow to pick.
+ *
+ * an osd that is too slow gets no reads and so no new samples, so its
+ * estimate decays toward the fastest one, halving the gap every
+ * @half_life, until it is tried again.
+ */
+uint64_t Objecter::calc_read_latencies(
+  const vector<pair<uint64_t, ceph::timespan>> &samples,
+  double factor, ceph::timespan half_life,
+  vector<uint64_t> *latencies)
+{
+  uint64_t best = 0;
+  for (auto& [l, age] : samples) {
+    if (l && (!best || l < best))
+      best = l;
+  }
+  for (auto& [l, age] : samples) {
+    if (l > best && half_life > ceph::timespan::zero()) {
+      double halvings = std::chrono::duration<double>(age) /
+	std::chrono::duration<double>(half_life);
+      latencies->push_back(best + (l - best) * std::exp2(-halvings));
+    } else {
+      latencies->push_back(l);
+    }
+  }
+  if (!best || factor < 1.0)
+    return std::numeric_limits<uint64_t>::max();
+  return best * factor;
+}
+
 Objecter::Objecter(CephContext *cct_, Messenger *m, MonClient *mc,
 		   Finisher *fin,
 		   double mon_timeout,
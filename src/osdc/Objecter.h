@@ -1478,6 +1478,8 @@ public:
     epoch_t *reply_epoch;
 
     ceph::coarse_mono_time stamp;
+    /// when a read was last sent; stamp is too coarse to time it
+    ceph::mono_time read_stamp;
 
     epoch_t map_dne_bound;
 
@@ -1949,6 +1951,13 @@ public:
     ConnectionRef con;
     int num_locks;
     std::unique_ptr<std::mutex[]> completion_locks;
+
+    /// smoothed latency (ns) of the reads this osd served, 0 until one
+    /// completes; used to pick a replica for balanced or localized reads
+    std::atomic<uint64_t> read_latency = {0};
+    /// mono_clock time (ns) of the last sample folded into read_latency
+    std::atomic<uint64_t> read_latency_stamp = {0};
+    void note_read_latency(ceph::timespan lat);
     using unique_completion_lock = std::unique_lock<
       decltype(completion_locks)::element_type>;
 
@@ -2033,6 +2042,14 @@ public:
   bool target_should_be_paused(op_target_t *op);
   int _calc_target(op_target_t *t, Connection *con,
 		   bool any_change = false);
+  uint64_t _get_read_latencies(const std::vector<int> &acting,
+			       std::vector<uint64_t> *latencies);
+ public:
+  static uint64_t calc_read_latencies(
+    const std::vector<std::pair<uint64_t, ceph::timespan>> &samples,
+    double factor, ceph::timespan half_life,
+    std::vector<uint64_t> *latencies);
+ private:
   int _map_session(op_target_t *op, OSDSession **s,
 		   shunique_lock& lc);
 
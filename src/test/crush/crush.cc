@@ -511,6 +511,24 @@ double calc_straw2_stddev(int *weights, int n, bool verbose)
   return stddev;
 }
 
+TEST_F(CRUSHTest, hash32_3_n) {
+  // the vector hash used for wide straw2 buckets must match the scalar
+  // one bit for bit, including the odd-sized tail
+  std::vector<__s32> b(67);
+  std::vector<__u32> out(b.size());
+  for (int t = 0; t < 1000; ++t) {
+    __u32 a = rand(), c = rand();
+    for (auto& i : b) {
+      i = rand() - RAND_MAX / 2;
+    }
+    unsigned n = rand() % b.size();
+    crush_hash32_3_n(CRUSH_HASH_RJENKINS1, a, b.data(), c, out.data(), n);
+    for (unsigned i = 0; i < n; ++i) {
+      ASSERT_EQ(crush_hash32_3(CRUSH_HASH_RJENKINS1, a, b[i], c), out[i]);
+    }
+  }
+}
+
 TEST_F(CRUSHTest, straw2_stddev)
 {
   int n = 15;
@@ -874,6 +874,62 @@ TEST_F(IsaErasureCodeTest, isa_xor_codec)
   EXPECT_EQ(5, cnt_cf);
 }
 
+TEST_F(IsaErasureCodeTest, apply_delta)
+{
+  // vandermonde and cauchy matrices, and the m=1 xor shortcut
+  const char *profiles[][3] = {
+    { "reed_sol_van", "3", "2" },
+    { "cauchy", "3", "2" },
+    { "reed_sol_van", "3", "1" },
+  };
+  for (auto p : profiles) {
+    ErasureCodeIsaDefault isa(tcache);
+    ErasureCodeProfile profile;
+    profile["technique"] = p[0];
+    profile["k"] = p[1];
+    profile["m"] = p[2];
+    EXPECT_EQ(0, isa.init(profile, &cerr));
+    EXPECT_TRUE(isa.supports_parity_delta());
+    int k = isa.get_data_chunk_count();
+    int n = isa.get_chunk_count();
+
+    bufferlist in;
+    for (unsigned i = 0; i < isa.get_alignment() * 4 * k; ++i)
+      in.append((char)(i * 7));
+    set<int> want_to_encode;
+    for (int i = 0; i < n; ++i)
+      want_to_encode.insert(i);
+    map<int, bufferlist> encoded;
+    EXPECT_EQ(0, isa.encode(want_to_encode, in, &encoded));
+    unsigned length = encoded[0].length();
+
+    // rewrite 32 bytes of the second data chunk
+    const unsigned off = 8, len = 32;
+    ASSERT_LE(off + len, length);
+    bufferlist changed;
+    changed.substr_of(in, 0, length + off);
+    changed.append(string(len, 'Z'));
+    bufferlist tail;
+    tail.substr_of(in, length + off + len, in.length() - length - off - len);
+    changed.append(tail);
+    map<int, bufferlist> reencoded;
+    EXPECT_EQ(0, isa.encode(want_to_encode, changed, &reencoded));
+
+    bufferptr old_data(encoded[1].c_str() + off, len);
+    bufferptr new_data(reencoded[1].c_str() + off, len);
+    bufferptr delta(len);
+    isa.encode_delta(old_data, new_data, &delta);
+    map<int, bufferptr> in_delta = { { 1, delta } };
+    map<int, bufferptr> coding;
+    for (int i = k; i < n; ++i)
+      coding[i] = bufferptr(encoded[i].c_str() + off, len);
+    isa.apply_delta(in_delta, coding);
+    for (int i = k; i < n; ++i)
+      EXPECT_EQ(0, memcmp(coding[i].c_str(), reencoded[i].c_str() + off, len))
+	<< p[0] << " m=" << p[2] << " chunk " << i;
+  }
+}
+
 TEST_F(IsaErasureCodeTest, create_rule)
 {
   std::unique_ptr<CrushWrapper> c = std::make_unique<CrushWrapper>();
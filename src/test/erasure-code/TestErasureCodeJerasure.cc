@@ -277,6 +277,52 @@ TEST(ErasureCodeTest, encode)
   }
 }
 
+TEST(ErasureCodeTest, apply_delta)
+{
+  const char *ws[] = { "8", "16", "32" };
+  for (auto w : ws) {
+    ErasureCodeJerasureReedSolomonVandermonde jerasure;
+    ErasureCodeProfile profile;
+    profile["k"] = "3";
+    profile["m"] = "2";
+    profile["w"] = w;
+    EXPECT_EQ(0, jerasure.init(profile, &cerr));
+    EXPECT_TRUE(jerasure.supports_parity_delta());
+
+    bufferlist in;
+    for (unsigned i = 0; i < jerasure.get_alignment() * 3; ++i)
+      in.append((char)(i * 7));
+    set<int> want_to_encode = { 0, 1, 2, 3, 4 };
+    map<int, bufferlist> encoded;
+    EXPECT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+    unsigned length = encoded[0].length();
+
+    // rewrite 32 bytes of the second data chunk
+    const unsigned off = 8, len = 32;
+    ASSERT_LE(off + len, length);
+    bufferlist changed;
+    changed.substr_of(in, 0, length + off);
+    changed.append(string(len, 'Z'));
+    bufferlist tail;
+    tail.substr_of(in, length + off + len, in.length() - length - off - len);
+    changed.append(tail);
+    map<int, bufferlist> reencoded;
+    EXPECT_EQ(0, jerasure.encode(want_to_encode, changed, &reencoded));
+
+    bufferptr old_data(encoded[1].c_str() + off, len);
+    bufferptr new_data(reencoded[1].c_str() + off, len);
+    bufferptr delta(len);
+    jerasure.encode_delta(old_data, new_data, &delta);
+    map<int, bufferptr> in_delta = { { 1, delta } };
+    map<int, bufferptr> coding;
+    for (int i = 3; i < 5; ++i)
+      coding[i] = bufferptr(encoded[i].c_str() + off, len);
+    jerasure.apply_delta(in_delta, coding);
+    for (int i = 3; i < 5; ++i)
+      EXPECT_EQ(0, memcmp(coding[i].c_str(), reencoded[i].c_str() + off, len));
+  }
+}
+
 TEST(ErasureCodeTest, create_rule)
 {
   std::unique_ptr<CrushWrapper> c = std::make_unique<CrushWrapper>();
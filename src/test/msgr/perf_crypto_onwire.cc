@@ -0,0 +1,215 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Compares msgr2 secure mode's AES-GCM handlers (crypto_onwire) against
+ * the straightforward scheme they replaced: one EVP call per plaintext
+ * buffer into a freshly allocated ciphertext buffer, and decryption into
+ * yet another buffer.  Frames are modelled on an OSD write: a preamble, a
+ * message header, a front made of many small buffers, and a data payload.
+ */
+
+#include <stdlib.h>
+#include <iostream>
+#include <memory>
+#include <openssl/evp.h>
+
+#include "auth/Auth.h"
+#include "common/ceph_argparse.h"
+#include "common/ceph_time.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "include/msgr.h"
+#include "msg/async/crypto_onwire.h"
+
+using namespace std;
+
+static constexpr size_t IV_LEN = 12;
+static constexpr size_t TAG_LEN = 16;
+
+// the per-buffer handler, as crypto_onwire used to do it
+class PerBufferGCM {
+  std::unique_ptr<EVP_CIPHER_CTX, decltype(&::EVP_CIPHER_CTX_free)> ectx;
+  std::unique_ptr<EVP_CIPHER_CTX, decltype(&::EVP_CIPHER_CTX_free)> dctx;
+  unsigned char iv[IV_LEN] = {};
+
+public:
+  explicit PerBufferGCM(const unsigned char* key)
+    : ectx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free),
+      dctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free) {
+    EVP_EncryptInit_ex(ectx.get(), EVP_aes_128_gcm(), nullptr, key, nullptr);
+    EVP_DecryptInit_ex(dctx.get(), EVP_aes_128_gcm(), nullptr, key, nullptr);
+  }
+
+  bufferlist encrypt(const bufferlist& plaintext) {
+    EVP_EncryptInit_ex(ectx.get(), nullptr, nullptr, nullptr, iv);
+    bufferlist out;
+    auto filler = out.append_hole(plaintext.length() + TAG_LEN);
+    for (const auto& buf : plaintext.buffers()) {
+      int len = 0;
+      EVP_EncryptUpdate(ectx.get(),
+			reinterpret_cast<unsigned char*>(filler.c_str()), &len,
+			reinterpret_cast<const unsigned char*>(buf.c_str()),
+			buf.length());
+      filler.advance(len);
+    }
+    int len = 0;
+    EVP_EncryptFinal_ex(ectx.get(),
+			reinterpret_cast<unsigned char*>(filler.c_str()), &len);
+    EVP_CIPHER_CTX_ctrl(ectx.get(), EVP_CTRL_GCM_GET_TAG, TAG_LEN,
+			filler.c_str());
+    return out;
+  }
+
+  bool decrypt(bufferlist&& ciphertext, bufferlist& tag) {
+    EVP_DecryptInit_ex(dctx.get(), nullptr, nullptr, nullptr, iv);
+    bufferptr plain(buffer::create_aligned(ciphertext.length(), CEPH_PAGE_SIZE));
+    int len = 0;
+    EVP_DecryptUpdate(dctx.get(),
+		      reinterpret_cast<unsigned char*>(plain.c_str()), &len,
+		      reinterpret_cast<const unsigned char*>(ciphertext.c_str()),
+		      ciphertext.length());
+    EVP_CIPHER_CTX_ctrl(dctx.get(), EVP_CTRL_GCM_SET_TAG, TAG_LEN,
+			tag.c_str());
+    return EVP_DecryptFinal_ex(dctx.get(), nullptr, &len) > 0;
+  }
+};
+
+static bufferlist make_frame(unsigned front_bufs, unsigned data_len)
+{
+  bufferlist bl;
+  bl.append_zero(32);					// preamble
+  bl.append_zero(sizeof(ceph_msg_header2));		// message header
+  for (unsigned i = 0; i < front_bufs; i++) {
+    bufferptr bp(64 + (i * 37) % 160);			// encoded op fields
+    bp.zero();
+    bl.push_back(std::move(bp));
+  }
+  if (data_len) {
+    bufferptr bp(buffer::create_page_aligned(data_len));
+    bp.zero();
+    bl.push_back(std::move(bp));
+  }
+  bl.append_zero((16 - bl.length() % 16) % 16);	// padding
+  bl.append_zero(16);					// epilogue
+  return bl;
+}
+
+// a frame as it comes off a socket: a buffer of its own
+static bufferlist fresh_copy(const bufferlist& bl, unsigned off, unsigned len)
+{
+  bufferlist out;
+  bufferptr bp(buffer::create_page_aligned(len));
+  bl.begin(off).copy(len, bp.c_str());
+  out.push_back(std::move(bp));
+  return out;
+}
+
+static void report(const char* what, ceph::timespan t, uint64_t bytes)
+{
+  const double secs = std::chrono::duration<double>(t).count();
+  cout << "  " << what << ": " << secs << "s, "
+       << (bytes / secs / (1 << 20)) << " MB/s" << std::endl;
+}
+
+void usage(const string &name) {
+  cout << "Usage: " << name << " [frames] [front buffers] [data bytes]" << std::endl;
+  cout << "       [frames]: how many frames to encrypt and decrypt" << std::endl;
+  cout << "       [front buffers]: small buffers in each frame's front" << std::endl;
+  cout << "       [data bytes]: data payload of each frame" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  if (args.size() < 3) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const unsigned frames = atoi(args[0]);
+  const unsigned front_bufs = atoi(args[1]);
+  const unsigned data_len = atoi(args[2]);
+
+  AuthConnectionMeta meta;
+  meta.con_mode = CEPH_CON_MODE_SECURE;
+  meta.connection_secret.assign(meta.get_connection_secret_length(), '\x5a');
+  auto tx_side = ceph::crypto::onwire::rxtx_t::create_handler_pair(
+    g_ceph_context, meta, false);
+  auto rx_side = ceph::crypto::onwire::rxtx_t::create_handler_pair(
+    g_ceph_context, meta, true);
+  PerBufferGCM per_buffer(
+    reinterpret_cast<const unsigned char*>(meta.connection_secret.data()));
+
+  const auto frame = make_frame(front_bufs, data_len);
+  const uint64_t bytes = uint64_t(frames) * frame.length();
+  cout << " frames " << frames << " of " << frame.length() << " bytes in "
+       << frame.get_num_buffers() << " buffers" << std::endl;
+
+  {
+    cout << " per-buffer EVP calls" << std::endl;
+    ceph::timespan enc{}, dec{};
+    for (unsigned i = 0; i < frames; i++) {
+      auto start = ceph::mono_clock::now();
+      auto ct = per_buffer.encrypt(frame);
+      enc += ceph::mono_clock::now() - start;
+
+      auto cipher = fresh_copy(ct, 0, frame.length());
+      auto tag = fresh_copy(ct, frame.length(), TAG_LEN);
+      start = ceph::mono_clock::now();
+      if (!per_buffer.decrypt(std::move(cipher), tag)) {
+	cerr << "per-buffer: auth tag mismatch" << std::endl;
+	return 1;
+      }
+      dec += ceph::mono_clock::now() - start;
+    }
+    report("encrypt", enc, bytes);
+    report("decrypt", dec, bytes);
+  }
+
+  {
+    cout << " crypto_onwire handlers" << std::endl;
+    ceph::timespan enc{}, dec{};
+    for (unsigned i = 0; i < frames; i++) {
+      auto start = ceph::mono_clock::now();
+      tx_side.tx->reset_tx_handler({ frame.length() });
+      tx_side.tx->authenticated_encrypt_update(frame);
+      auto ct = tx_side.tx->authenticated_encrypt_final();
+      enc += ceph::mono_clock::now() - start;
+
+      auto cipher = fresh_copy(ct, 0, frame.length());
+      auto tag = fresh_copy(ct, frame.length(), TAG_LEN);
+      start = ceph::mono_clock::now();
+      try {
+	rx_side.rx->reset_rx_handler();
+	rx_side.rx->authenticated_decrypt_update(std::move(cipher),
+						 CEPH_PAGE_SIZE);
+	rx_side.rx->authenticated_decrypt_update_final(std::move(tag), 1);
+      } catch (const ceph::crypto::onwire::MsgAuthError&) {
+	cerr << "crypto_onwire: auth tag mismatch" << std::endl;
+	return 1;
+      }
+      dec += ceph::mono_clock::now() - start;
+    }
+    report("encrypt", enc, bytes);
+    report("decrypt", dec, bytes);
+  }
+
+  return 0;
+}
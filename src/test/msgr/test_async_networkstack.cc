@@ -578,6 +578,89 @@ TEST_P(NetworkWorkerTest, ComplexTest) {
   });
 }
 
+TEST_P(NetworkWorkerTest, ZeroCopyCloseTest) {
+  if (strcmp(GetParam(), "posix")) {
+    GTEST_SKIP() << "MSG_ZEROCOPY sends are posix only";
+  }
+  entity_addr_t bind_addr;
+  ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
+  exec_events([this, bind_addr](Worker *worker) mutable {
+    if (worker->id != 0)
+      return;
+    entity_addr_t cli_addr;
+    EventCenter *center = &worker->center;
+    SocketOptions options;
+    options.zerocopy_min_size = 4096;
+    ServerSocket bind_socket;
+    int r = worker->listen(bind_addr, 0, options, &bind_socket);
+    ASSERT_EQ(0, r);
+
+    ConnectedSocket cli_socket, srv_socket;
+    r = worker->connect(bind_addr, options, &cli_socket);
+    ASSERT_EQ(0, r);
+    {
+      C_poll cb(center);
+      center->create_file_event(bind_socket.fd(), EVENT_READABLE, &cb);
+      ASSERT_TRUE(cb.poll(500));
+      r = bind_socket.accept(&srv_socket, options, &cli_addr, worker);
+      ASSERT_EQ(0, r);
+      center->delete_file_event(bind_socket.fd(), EVENT_READABLE);
+    }
+    {
+      C_poll cb(center);
+      center->create_file_event(cli_socket.fd(), EVENT_READABLE, &cb);
+      r = cli_socket.is_connected();
+      if (r == 0) {
+        ASSERT_TRUE(cb.poll(500));
+        r = cli_socket.is_connected();
+      }
+      ASSERT_EQ(1, r);
+      center->delete_file_event(cli_socket.fd(), EVENT_READABLE);
+    }
+
+    // the server doesn't read yet, so the sends are still outstanding
+    // when the client closes
+    bufferptr bp(buffer::create_page_aligned(64 << 10));
+    memset(bp.c_str(), 'a', bp.length());
+    ssize_t sent = 0;
+    for (int i = 0; i < 4; i++) {
+      bufferlist bl;
+      bl.append(bp);
+      r = cli_socket.send(bl, false);
+      ASSERT_GE(r, 0);
+      sent += r;
+    }
+    cli_socket.shutdown();
+    cli_socket.close();
+    // nothing the socket sent is referenced any more; reuse the pages
+    ASSERT_EQ(1, bp.raw_nref());
+    memset(bp.c_str(), 'b', bp.length());
+
+    // whatever reaches the peer was sent before the pages were reused
+    char buf[4096];
+    ssize_t received = 0;
+    C_poll cb(center);
+    center->create_file_event(srv_socket.fd(), EVENT_READABLE, &cb);
+    while (true) {
+      r = srv_socket.read(buf, sizeof(buf));
+      if (r == -EAGAIN) {
+	ASSERT_TRUE(cb.poll(500));
+	cb.reset();
+	continue;
+      }
+      if (r <= 0)
+	break;
+      ASSERT_EQ(std::string(r, 'a'), std::string(buf, r));
+      received += r;
+    }
+    center->delete_file_event(srv_socket.fd(), EVENT_READABLE);
+    ASSERT_TRUE(r == 0 || r == -ECONNRESET);
+    ASSERT_LE(received, sent);
+    srv_socket.close();
+    bind_socket.abort_accept();
+  });
+}
+
 class StressFactory {
   struct Client;
   struct Server;
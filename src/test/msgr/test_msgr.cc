@@ -23,6 +23,7 @@
 #include <list>
 #include "common/ceph_mutex.h"
 #include "common/ceph_argparse.h"
+#include "common/perf_counters_collection.h"
 #include "global/global_init.h"
 #include "msg/Dispatcher.h"
 #include "msg/msg_types.h"
@@ -41,6 +42,7 @@ typedef boost::mt11213b gen_type;
 
 #include "common/dout.h"
 #include "include/ceph_assert.h"
+#include "include/scope_guard.h"
 
 #include "auth/DummyAuth.h"
 
@@ -110,6 +112,7 @@ class FakeDispatcher : public Dispatcher {
   bool loopback;
   entity_addrvec_t last_accept;
   ConnectionRef *last_accept_con_ptr = nullptr;
+  bufferlist last_data;
 
   explicit FakeDispatcher(bool s): Dispatcher(g_ceph_context),
                           is_server(s), got_new(false), got_remote_reset(false),
@@ -208,8 +211,10 @@ class FakeDispatcher : public Dispatcher {
     } else if (loopback) {
       ceph_assert(m->get_source().is_client());
     }
+    bufferlist data = m->get_data();
     m->put();
     std::lock_guard l{lock};
+    last_data = std::move(data);
     got_new = true;
     cond.notify_all();
   }
@@ -1468,6 +1473,148 @@ TEST_P(MessengerTest, MessageTest) {
   client_msgr->wait();
 }
 
+TEST_P(MessengerTest, CompressionTest) {
+  g_ceph_context->_conf.set_val("ms_client_compress_mode", "force");
+  g_ceph_context->_conf.set_val("ms_compression_algorithm", "zstd snappy");
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  // a highly compressible data segment, plus a tiny message that stays
+  // under ms_compress_min_size
+  for (unsigned len : { 1u << 20, 16u }) {
+    bufferlist bl;
+    string s("abcdefghijklmnopqrstuvwxyz");
+    while (bl.length() < len)
+      bl.append(s);
+    MPing *m = new MPing();
+    m->set_data(bl);
+    conn->send_message(m);
+    std::unique_lock l{srv_dispatcher.lock};
+    srv_dispatcher.cond.wait(l, [&] { return srv_dispatcher.got_new; });
+    srv_dispatcher.got_new = false;
+    ASSERT_TRUE(srv_dispatcher.last_data.contents_equal(bl));
+  }
+  ASSERT_TRUE(conn->is_connected());
+
+  server_msgr->shutdown();
+  client_msgr->shutdown();
+  server_msgr->wait();
+  client_msgr->wait();
+  g_ceph_context->_conf.set_val("ms_client_compress_mode", "none");
+  g_ceph_context->_conf.set_val("ms_compression_algorithm", "snappy");
+}
+
+TEST_P(MessengerTest, DataAlignmentTest) {
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  // the byte at logical offset data_off must land on a page boundary
+  for (unsigned off : { 0u, 100u, 4000u }) {
+    bufferlist bl;
+    bl.append_zero(3 * CEPH_PAGE_SIZE + 123);
+    MPing *m = new MPing();
+    m->set_data(bl);
+    m->get_header().data_off = off;
+    conn->send_message(m);
+    std::unique_lock l{srv_dispatcher.lock};
+    srv_dispatcher.cond.wait(l, [&] { return srv_dispatcher.got_new; });
+    srv_dispatcher.got_new = false;
+    ASSERT_EQ(bl.length(), srv_dispatcher.last_data.length());
+    const unsigned head = (CEPH_PAGE_SIZE - (off & ~CEPH_PAGE_MASK)) &
+			  ~CEPH_PAGE_MASK;
+    auto p = srv_dispatcher.last_data.cbegin(head);
+    ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(p.get_current_ptr().c_str()) &
+		  ~CEPH_PAGE_MASK);
+  }
+  ASSERT_TRUE(conn->is_connected());
+
+  server_msgr->shutdown();
+  client_msgr->shutdown();
+  server_msgr->wait();
+  client_msgr->wait();
+}
+
+// sum of a counter over the async messenger workers
+static uint64_t get_worker_counter(const std::string& name)
+{
+  uint64_t sum = 0;
+  g_ceph_context->get_perfcounters_collection()->with_counters(
+    [&](const PerfCountersCollectionImpl::CounterMap& by_path) {
+      for (auto& [path, ref] : by_path) {
+	if (path.compare(0, 22, "AsyncMessenger::Worker") == 0 &&
+	    path.substr(path.rfind('.') + 1) == name) {
+	  sum += ref.data->u64;
+	}
+      }
+    });
+  return sum;
+}
+
+TEST_P(MessengerTest, BatchingTest) {
+  // make every send after the first one fall into the window, which has
+  // to be longer than the event loop timers' resolution to be honoured
+  g_ceph_context->_conf.set_val("ms_async_batch_window_us", "20000");
+  auto reset_window = make_scope_guard([] {
+    g_ceph_context->_conf.set_val("ms_async_batch_window_us", "0");
+  });
+  const uint64_t messages_before = get_worker_counter("msgr_send_messages");
+  const uint64_t syscalls_before = get_worker_counter("msgr_send_syscalls");
+  const uint64_t deferred_before = get_worker_counter("msgr_send_deferred");
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  const unsigned num = 100;
+  for (unsigned i = 0; i < num; i++) {
+    conn->send_message(new MPing());
+  }
+  {
+    // the server replies to each ping, from behind its own window
+    std::unique_lock l{cli_dispatcher.lock};
+    cli_dispatcher.cond.wait(l, [&] {
+      auto s = static_cast<Session*>(conn->get_priv().get());
+      return s && s->get_count() == num;
+    });
+  }
+  ASSERT_TRUE(conn->is_connected());
+
+  // the pings and their replies went out in far fewer socket writes
+  const uint64_t messages =
+    get_worker_counter("msgr_send_messages") - messages_before;
+  const uint64_t syscalls =
+    get_worker_counter("msgr_send_syscalls") - syscalls_before;
+  ASSERT_GE(messages, 2 * num);
+  ASSERT_LT(syscalls, messages);
+  ASSERT_GT(get_worker_counter("msgr_send_deferred"), deferred_before);
+
+  server_msgr->shutdown();
+  client_msgr->shutdown();
+  server_msgr->wait();
+  client_msgr->wait();
+}
 
 class SyntheticWorkload;
 
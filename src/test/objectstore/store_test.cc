@@ -1410,6 +1410,85 @@ TEST_P(StoreTestSpecificAUSize, ReproBug41901Test) {
 }
 
 
+TEST_P(StoreTestSpecificAUSize, KernelDeviceIoringTest) {
+  if(string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_ioring", "true");
+  // falls back to regular submission where the kernel won't allow it
+  SetVal(g_conf(), "bdev_ioring_sqthread_poll", "true");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(4096);
+
+  // io_uring where the kernel has it, libaio otherwise
+  map<string,string> pm;
+  store->collect_metadata(&pm);
+  ASSERT_EQ(1u, pm.count("bluestore_bdev_aio_engine"));
+  cerr << "aio engine " << pm["bluestore_bdev_aio_engine"] << std::endl;
+  ASSERT_TRUE(pm["bluestore_bdev_aio_engine"] == "io_uring" ||
+	      pm["bluestore_bdev_aio_engine"] == "libaio");
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  bufferlist bl;
+  bl.append(std::string(1 << 20, 'a'));
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  {
+    bufferlist in;
+    r = store->read(ch, hoid, 0, bl.length(), in);
+    ASSERT_EQ((int)bl.length(), r);
+    ASSERT_TRUE(bl_eq(bl, in));
+  }
+
+  // BlueStore and BlueFS each have a device instance, and so a
+  // bdev-block* counter set, for the shared main device
+  uint64_t submit_batches = 0, submit_ops = 0, reap_batches = 0, reap_ops = 0;
+  g_ceph_context->get_perfcounters_collection()->with_counters(
+    [&](const PerfCountersCollectionImpl::CounterMap& by_path) {
+      for (auto& [path, ref] : by_path) {
+	if (path.compare(0, 5, "bdev-") != 0) {
+	  continue;
+	}
+	auto counter = path.substr(path.rfind('.') + 1);
+	if (counter == "aio_submit_batches") {
+	  submit_batches += ref.data->u64;
+	} else if (counter == "aio_submit_ops") {
+	  submit_ops += ref.data->u64;
+	} else if (counter == "aio_reap_batches") {
+	  reap_batches += ref.data->u64;
+	} else if (counter == "aio_reap_ops") {
+	  reap_ops += ref.data->u64;
+	}
+      }
+    });
+  ASSERT_GT(submit_batches, 0u);
+  ASSERT_GE(submit_ops, submit_batches);
+  ASSERT_GT(reap_batches, 0u);
+  ASSERT_GE(reap_ops, reap_batches);
+  ASSERT_GE(submit_ops, reap_ops);
+
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, BluestoreStatFSTest) {
   if(string(GetParam()) != "bluestore")
     return;
@@ -7971,6 +8050,115 @@ TEST_P(StoreTestSpecificAUSize, fsckOnUnalignedDevice2) {
   store->mount();
 }
 
+TEST_P(StoreTestSpecificAUSize, BluestoreAllocSnapshot) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_alloc_snapshot", "true");
+  SetVal(g_conf(), "bluestore_fsck_on_mount", "false");
+  SetVal(g_conf(), "bluestore_fsck_on_umount", "false");
+  StartDeferred(0x10000);
+
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  bufferlist bl;
+  bl.append(std::string(0x30000, 'a'));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    for (unsigned i = 0; i < 16; ++i) {
+      ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i),
+					 CEPH_NOSNAP)));
+      t.write(cid, hoid, 0, bl.length(), bl);
+    }
+    ASSERT_EQ(queue_transaction(store, ch, std::move(t)), 0);
+  }
+  {
+    // punch holes into the allocated space
+    ObjectStore::Transaction t;
+    for (unsigned i = 0; i < 16; i += 2) {
+      ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i),
+					 CEPH_NOSNAP)));
+      t.remove(cid, hoid);
+    }
+    ASSERT_EQ(queue_transaction(store, ch, std::move(t)), 0);
+  }
+  ch.reset();
+
+  store_statfs_t before, after;
+  ASSERT_EQ(store->statfs(&before), 0);
+
+  // mount from the snapshot
+  ASSERT_EQ(store->umount(), 0);
+  ASSERT_EQ(store->mount(), 0);
+  ASSERT_EQ(store->statfs(&after), 0);
+  ASSERT_EQ(before.available, after.available);
+  ASSERT_EQ(before.allocated, after.allocated);
+
+  // read-only fsck leaves the snapshot in place for the next mount
+  ASSERT_EQ(store->umount(), 0);
+  ASSERT_EQ(store->fsck(false), 0);
+  ASSERT_EQ(store->mount(), 0);
+  ASSERT_EQ(store->statfs(&after), 0);
+  ASSERT_EQ(before.available, after.available);
+}
+
+TEST_P(StoreTestSpecificAUSize, BluestoreDefrag) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_defrag_bytes_per_sec", "1048576");
+  SetVal(g_conf(), "bluestore_defrag_min_extents", "8");
+  StartDeferred(0x1000);
+  const PerfCounters* logger = store->get_perf_counters();
+
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  ghobject_t hoid2(hobject_t(sobject_t("Object 2", CEPH_NOSNAP)));
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    ASSERT_EQ(queue_transaction(store, ch, std::move(t)), 0);
+  }
+  // interleave allocations of two objects and write the first one
+  // backwards so that none of its extents are physically adjacent
+  const unsigned blocks = 16;
+  bufferlist expected;
+  for (unsigned i = 0; i < blocks; ++i) {
+    bufferlist bl;
+    bl.append(std::string(0x1000, 'a' + i));
+    expected.append(bl);
+  }
+  for (unsigned i = blocks; i > 0; --i) {
+    ObjectStore::Transaction t;
+    bufferlist bl, bl2;
+    bl.substr_of(expected, (i - 1) * 0x1000, 0x1000);
+    bl2.append(std::string(0x1000, 'z'));
+    t.write(cid, hoid, (i - 1) * 0x1000, bl.length(), bl);
+    t.write(cid, hoid2, (i - 1) * 0x1000, bl2.length(), bl2);
+    ASSERT_EQ(queue_transaction(store, ch, std::move(t)), 0);
+  }
+
+  for (unsigned i = 0; i < 200 && logger->get(l_bluestore_defrag_objects) == 0;
+       ++i) {
+    usleep(100000);
+  }
+  ASSERT_GE(logger->get(l_bluestore_defrag_objects), 1u);
+  ASSERT_GE(logger->get(l_bluestore_defrag_bytes), blocks * 0x1000);
+  ASSERT_LT(logger->get(l_bluestore_defrag_extents_after),
+	    logger->get(l_bluestore_defrag_extents_before));
+
+  bufferlist bl;
+  ASSERT_EQ(store->read(ch, hoid, 0, blocks * 0x1000, bl),
+	    (int)(blocks * 0x1000));
+  ASSERT_TRUE(bl_eq(expected, bl));
+  ch.reset();
+  ASSERT_EQ(store->umount(), 0);
+  ASSERT_EQ(store->fsck(false), 0);
+  ASSERT_EQ(store->mount(), 0);
+}
+
 namespace {
   ghobject_t make_object(const char* name, int64_t pool) {
     sobject_t soid{name, CEPH_NOSNAP};
@@ -8498,6 +8686,67 @@ TEST_P(StoreTest, SpuriousReadErrorTest) {
   }
 }
 
+TEST_P(StoreTest, VerifyDataTest) {
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  ghobject_t hoid(hobject_t(sobject_t("foo", CEPH_NOSNAP)));
+  ghobject_t hoid2(hobject_t(sobject_t("foo2", CEPH_NOSNAP)));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  if (string(GetParam()) != "bluestore") {
+    ASSERT_EQ(-EOPNOTSUPP, store->verify_data(ch, hoid, 0, 0x1000));
+    return;
+  }
+  SetVal(g_conf(), "bluestore_csum_type", "crc32c");
+  SetVal(g_conf(), "bluestore_retry_disk_reads", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  bufferlist test_data;
+  bufferptr ap(0x5000);
+  memset(ap.c_str(), 'a', 0x5000);
+  test_data.append(ap);
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, 0x5000, test_data);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    EXPECT_EQ(store->umount(), 0);
+    EXPECT_EQ(store->mount(), 0);
+    ch = store->open_collection(cid);
+  }
+  ASSERT_EQ(0x5000, store->verify_data(ch, hoid, 0, 0x8000));
+  ASSERT_EQ(0x1000, store->verify_data(ch, hoid, 0x4000, 0x2000));
+  ASSERT_EQ(0, store->verify_data(ch, hoid, 0x6000, 0x1000));
+  ASSERT_EQ(-ENOENT, store->verify_data(
+    ch, ghobject_t(hobject_t(sobject_t("bar", CEPH_NOSNAP))), 0, 0x1000));
+
+  SetVal(g_conf(), "bluestore_debug_inject_csum_err_probability", "1");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  ASSERT_EQ(-EIO, store->verify_data(ch, hoid, 0, 0x5000));
+  SetVal(g_conf(), "bluestore_debug_inject_csum_err_probability", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  {
+    // no csums, no verification
+    SetVal(g_conf(), "bluestore_csum_type", "none");
+    g_ceph_context->_conf.apply_changes(nullptr);
+    ObjectStore::Transaction t;
+    t.write(cid, hoid2, 0, 0x5000, test_data);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    EXPECT_EQ(store->umount(), 0);
+    EXPECT_EQ(store->mount(), 0);
+    ch = store->open_collection(cid);
+  }
+  ASSERT_EQ(0x5000, store->verify_data(ch, hoid, 0, 0x5000));
+  ASSERT_EQ(-EOPNOTSUPP, store->verify_data(ch, hoid2, 0, 0x5000));
+}
+
 TEST_P(StoreTest, allocateBlueFSTest) {
   if (string(GetParam()) != "bluestore")
     return;
@@ -172,6 +172,106 @@ TEST(BlueFS, write_read) {
   fs.umount();
 }
 
+TEST(BlueFS, random_read_readahead) {
+  uint64_t size = 1048576 * 128;
+  TempBdev bdev{size};
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+  ASSERT_EQ(0, fs.mount());
+  const unsigned file_size = 4 * 1048576;
+  std::unique_ptr<char[]> data = gen_buffer(file_size);
+  {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.mkdir("dir"));
+    ASSERT_EQ(0, fs.open_for_write("dir", "file", &h, false));
+    h->append(data.get(), file_size);
+    fs.fsync(h);
+    fs.close_writer(h);
+  }
+  {
+    // walk the file like an iterator does, through random reads
+    BlueFS::FileReader *h;
+    ASSERT_EQ(0, fs.open_for_read("dir", "file", &h, true));
+    char out[4000];
+    unsigned reads = 0;
+    for (uint64_t off = 0; off < file_size; off += sizeof(out), ++reads) {
+      int64_t r = fs.read_random(h, off, sizeof(out), out);
+      ASSERT_EQ(std::min<uint64_t>(sizeof(out), file_size - off), (uint64_t)r);
+      ASSERT_EQ(0, memcmp(out, data.get() + off, r));
+    }
+    // a read elsewhere ends the run and must still return the right data
+    ASSERT_EQ(100, fs.read_random(h, 12345, 100, out));
+    ASSERT_EQ(0, memcmp(out, data.get() + 12345, 100));
+    delete h;
+
+    auto ra = fs.get_perf_counters()->get(
+      l_bluefs_read_random_readahead_count);
+    ASSERT_LT(0u, ra);
+    ASSERT_GT(reads / 8, ra);
+  }
+  fs.umount();
+}
+
+TEST(BlueFS, random_read_readahead_max_total) {
+  // room for one reader's window (64K, plus the unaligned head of the
+  // read that triggers it), but not two
+  g_ceph_context->_conf.set_val("bluefs_max_prefetch", "65536");
+  g_ceph_context->_conf.set_val("bluefs_readahead_min", "65536");
+  g_ceph_context->_conf.set_val("bluefs_readahead_max_total", "98304");
+  uint64_t size = 1048576 * 128;
+  TempBdev bdev{size};
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+  ASSERT_EQ(0, fs.mount());
+  const unsigned file_size = 1048576;
+  std::unique_ptr<char[]> data = gen_buffer(file_size);
+  {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.mkdir("dir"));
+    ASSERT_EQ(0, fs.open_for_write("dir", "file", &h, false));
+    h->append(data.get(), file_size);
+    fs.fsync(h);
+    fs.close_writer(h);
+  }
+  auto walk = [&](BlueFS::FileReader *h, uint64_t from, uint64_t to) {
+    char out[4000];
+    for (uint64_t off = from; off < to; off += sizeof(out)) {
+      int64_t r = fs.read_random(h, off, sizeof(out), out);
+      ASSERT_EQ(std::min<uint64_t>(sizeof(out), file_size - off), (uint64_t)r);
+      ASSERT_EQ(0, memcmp(out, data.get() + off, r));
+    }
+  };
+  auto readaheads = [&]() {
+    return fs.get_perf_counters()->get(l_bluefs_read_random_readahead_count);
+  };
+  BlueFS::FileReader *h1, *h2;
+  ASSERT_EQ(0, fs.open_for_read("dir", "file", &h1, true));
+  ASSERT_EQ(0, fs.open_for_read("dir", "file", &h2, true));
+
+  walk(h1, 0, file_size / 2);
+  auto ra = readaheads();
+  ASSERT_LT(0u, ra);
+  // h1 keeps its window, which leaves no room for h2's
+  walk(h2, 0, file_size / 2);
+  ASSERT_EQ(ra, readaheads());
+  // closing h1 gives it back
+  delete h1;
+  walk(h2, file_size / 2, file_size);
+  ASSERT_LT(ra, readaheads());
+  delete h2;
+  fs.umount();
+
+  g_ceph_context->_conf.rm_val("bluefs_max_prefetch");
+  g_ceph_context->_conf.rm_val("bluefs_readahead_min");
+  g_ceph_context->_conf.rm_val("bluefs_readahead_max_total");
+}
+
 TEST(BlueFS, small_appends) {
   uint64_t size = 1048576 * 128;
   TempBdev bdev{size};
@@ -592,6 +692,10 @@ TEST(BlueFS, test_simple_compaction_async) {
     }
   }
   fs.compact_log();
+  // the lock is held over (at least) three separate stretches
+  auto held = fs.get_perf_counters()->get_tavg_ns(
+    l_bluefs_log_compaction_lock_lat);
+  ASSERT_LE(3u, held.first);
   fs.umount();
 }
 
@@ -308,6 +308,60 @@ TEST(bluestore_blob_t, calc_csum)
   }
 }
 
+TEST(bluestore_blob_t, csum_fragmented)
+{
+  // the same data as a single buffer and split into pieces that make
+  // csum blocks straddle buffer boundaries
+  bufferptr bp(0x10000);
+  for (unsigned i = 0; i < bp.length(); ++i)
+    bp.c_str()[i] = (i * 7) & 0xff;
+  bufferlist whole;
+  whole.append(bp);
+  bufferlist frag;
+  unsigned sizes[] = {1, 0x1fff, 0x1000, 0x3001, 0x800, 0x800, 0x2000};
+  unsigned off = 0;
+  for (unsigned i = 0; off < bp.length(); ++i) {
+    unsigned l = std::min<unsigned>(sizes[i % std::size(sizes)],
+				    bp.length() - off);
+    bufferptr piece(bp.c_str() + off, l);
+    frag.append(piece);
+    off += l;
+  }
+  ASSERT_TRUE(whole.contents_equal(frag));
+
+  for (unsigned csum_type = Checksummer::CSUM_NONE + 1;
+       csum_type < Checksummer::CSUM_MAX;
+       ++csum_type) {
+    cout << "csum_type " << Checksummer::get_csum_type_string(csum_type)
+	 << std::endl;
+    bluestore_blob_t a, b;
+    a.init_csum(csum_type, 12, whole.length());
+    b.init_csum(csum_type, 12, whole.length());
+    a.calc_csum(0, whole);
+    b.calc_csum(0, frag);
+    ASSERT_EQ(a.csum_data.length(), b.csum_data.length());
+    ASSERT_EQ(0, memcmp(a.csum_data.c_str(), b.csum_data.c_str(),
+			a.csum_data.length()));
+
+    int bad_off;
+    uint64_t bad_csum;
+    ASSERT_EQ(0, a.verify_csum(0, frag, &bad_off, &bad_csum));
+    ASSERT_EQ(-1, bad_off);
+
+    // corrupt a block that straddles two buffers
+    bufferlist bad;
+    bad.substr_of(frag, 0, 0x2000);
+    bufferptr z(1);
+    z.c_str()[0] = ~bp.c_str()[0x2000];
+    bad.append(z);
+    bufferlist rest;
+    rest.substr_of(frag, 0x2001, frag.length() - 0x2001);
+    bad.claim_append(rest);
+    ASSERT_EQ(-1, a.verify_csum(0, bad, &bad_off, &bad_csum));
+    ASSERT_EQ(0x2000, bad_off);
+  }
+}
+
 TEST(bluestore_blob_t, csum_bench)
 {
   bufferlist bl;
@@ -1044,6 +1098,78 @@ TEST(Blob, legacy_decode)
   }
 }
 
+TEST(OnodeCacheShard, trim)
+{
+  BlueStore store(g_ceph_context, "", 4096);
+  BlueStore::OnodeCacheShard *oc = BlueStore::OnodeCacheShard::create(
+    g_ceph_context, "lru", NULL);
+  BlueStore::BufferCacheShard *bc = BlueStore::BufferCacheShard::create(
+    g_ceph_context, "lru", NULL);
+
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc, bc, coll_t());
+  auto cached = [&](const ghobject_t& oid) {
+    return coll->onode_map.map_any([&](BlueStore::OnodeRef o) {
+      return o->oid == oid;
+    });
+  };
+  oc->set_max(4);
+
+  vector<ghobject_t> oids;
+  vector<BlueStore::OnodeRef> in_use;
+  for (unsigned i = 0; i < 8; ++i) {
+    oids.emplace_back(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+    BlueStore::OnodeRef o(new BlueStore::Onode(coll.get(), oids.back(), ""));
+    coll->onode_map.add(oids.back(), o);
+    if (i < 2) {
+      in_use.push_back(o);
+    }
+  }
+  // onodes that are referenced outside of the cache survive trimming
+  ASSERT_EQ(4u, oc->_get_num());
+  ASSERT_TRUE(cached(oids[0]));
+  ASSERT_TRUE(cached(oids[1]));
+  ASSERT_TRUE(cached(oids[7]));
+  ASSERT_FALSE(cached(oids[2]));
+
+  // so do recently looked up ones, but only once
+  in_use.clear();
+  BlueStore::OnodeRef o(new BlueStore::Onode(coll.get(), oids[2], ""));
+  coll->onode_map.add(oids[2], o);
+  o->referenced = true;
+  o.reset();
+  {
+    std::lock_guard l(oc->lock);
+    oc->_trim_to(1);
+  }
+  ASSERT_EQ(1u, oc->_get_num());
+  ASSERT_TRUE(cached(oids[2]));
+  {
+    std::lock_guard l(oc->lock);
+    oc->_trim_to(0);
+  }
+  ASSERT_TRUE(cached(oids[2]));
+  {
+    std::lock_guard l(oc->lock);
+    oc->_trim_to(0);
+  }
+  ASSERT_EQ(0u, oc->_get_num());
+  ASSERT_TRUE(coll->onode_map.empty());
+
+  // a cache full of onodes in use does not spin
+  for (unsigned i = 0; i < 4; ++i) {
+    in_use.emplace_back(new BlueStore::Onode(coll.get(), oids[i], ""));
+    coll->onode_map.add(oids[i], in_use.back());
+  }
+  {
+    std::lock_guard l(oc->lock);
+    oc->_trim_to(0);
+  }
+  ASSERT_EQ(4u, oc->_get_num());
+  in_use.clear();
+  oc->flush();
+  ASSERT_TRUE(coll->onode_map.empty());
+}
+
 TEST(ExtentMap, seek_lextent)
 {
   BlueStore store(g_ceph_context, "", 4096);
@@ -1097,6 +1223,46 @@ TEST(ExtentMap, seek_lextent)
   ASSERT_EQ(em.extent_map.end(), em.seek_lextent(500));
 }
 
+TEST(ExtentMap, decode_some_between_loaded)
+{
+  BlueStore store(g_ceph_context, "", 4096);
+  BlueStore::OnodeCacheShard *oc = BlueStore::OnodeCacheShard::create(
+    g_ceph_context, "lru", NULL);
+  BlueStore::BufferCacheShard *bc = BlueStore::BufferCacheShard::create(
+    g_ceph_context, "lru", NULL);
+
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc, bc, coll_t());
+  BlueStore::Onode onode(coll.get(), ghobject_t(), "");
+  BlueStore::ExtentMap src(&onode);
+  for (unsigned i = 0; i < 8; ++i) {
+    BlueStore::BlobRef b(new BlueStore::Blob);
+    b->shared_blob = new BlueStore::SharedBlob(coll.get());
+    b->dirty_blob().allocated_test(
+      bluestore_pextent_t(0x100000 + i * 0x1000, 0x1000));
+    src.extent_map.insert(*new BlueStore::Extent(i * 0x1000, 0, 0x1000, b));
+  }
+  bufferlist bl;
+  unsigned n = 0;
+  ASSERT_FALSE(src.encode_some(0x2000, 0x4000, bl, &n));
+  ASSERT_EQ(4u, n);
+
+  // the range is decoded between extents that are already loaded,
+  // as when a middle shard is faulted in last
+  BlueStore::ExtentMap em(&onode);
+  BlueStore::BlobRef br(new BlueStore::Blob);
+  br->shared_blob = new BlueStore::SharedBlob(coll.get());
+  em.extent_map.insert(*new BlueStore::Extent(0, 0, 0x2000, br));
+  em.extent_map.insert(*new BlueStore::Extent(0x6000, 0, 0x2000, br));
+  ASSERT_EQ(4u, em.decode_some(bl));
+  ASSERT_EQ(6u, em.extent_map.size());
+  uint32_t expected[] = {0, 0x2000, 0x3000, 0x4000, 0x5000, 0x6000};
+  unsigned i = 0;
+  for (auto& e : em.extent_map) {
+    ASSERT_EQ(expected[i], e.logical_offset);
+    ++i;
+  }
+}
+
 TEST(ExtentMap, has_any_lextents)
 {
   BlueStore store(g_ceph_context, "", 4096);
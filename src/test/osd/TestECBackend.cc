@@ -58,3 +58,54 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+
+TEST(ECUtil, offset_len_to_chunk_range)
+{
+  const uint64_t swidth = 4096;
+  const uint64_t ssize = 4;
+  const uint64_t csize = swidth / ssize;
+
+  ECUtil::stripe_info_t s(ssize, swidth);
+  ASSERT_EQ(s.get_data_chunk_count(), ssize);
+
+  // within one chunk of the second stripe
+  ASSERT_EQ(s.offset_len_to_chunk_range(make_pair(swidth + csize + 10,
+						  (uint64_t)20), 1),
+	    make_pair(csize + 10, (uint64_t)20));
+  ASSERT_EQ(s.offset_len_to_chunk_range(make_pair(swidth + csize + 10,
+						  (uint64_t)20), 0),
+	    make_pair((uint64_t)0, (uint64_t)0));
+
+  // across a stripe boundary, chunk 0 only holds the tail
+  pair<uint64_t, uint64_t> in(swidth - 10, 20);
+  ASSERT_EQ(s.offset_len_to_chunk_range(in, 3),
+	    make_pair(csize - 10, (uint64_t)10));
+  ASSERT_EQ(s.offset_len_to_chunk_range(in, 0),
+	    make_pair(csize, (uint64_t)10));
+  set<int> chunks;
+  s.offset_len_to_data_chunks(in, &chunks);
+  ASSERT_EQ(chunks, (set<int>{0, 3}));
+
+  // full stripes need whole chunks
+  ASSERT_EQ(s.offset_len_to_chunk_range(make_pair(swidth, 2 * swidth), 2),
+	    make_pair(csize, 2 * csize));
+
+  // reassembling the chunk ranges gives back the logical data
+  bufferlist data;
+  for (unsigned i = 0; i < 3 * swidth; ++i) {
+    data.append((char)(i * 7));
+  }
+  in = make_pair(csize / 2, 2 * swidth);
+  map<int, bufferlist> shards;
+  for (unsigned i = 0; i < ssize; ++i) {
+    auto r = s.offset_len_to_chunk_range(in, i);
+    for (uint64_t off = r.first; off < r.first + r.second; ++off) {
+      uint64_t logical = (off / csize) * swidth + i * csize + off % csize;
+      shards[i].append(data.c_str()[logical]);
+    }
+  }
+  bufferlist out, expected;
+  ECUtil::assemble(s, in.first, in.second, shards, &out);
+  expected.substr_of(data, in.first, in.second);
+  ASSERT_TRUE(out.contents_equal(expected));
+}
@@ -295,6 +295,103 @@ TEST_F(OSDMapTest, MapFunctionsMatch) {
   EXPECT_EQ(acting_osds, acting_osds_two);
 }
 
+TEST_F(OSDMapTest, MappingDeltaUpdate) {
+  set_up_map(20);
+  mapping.update(osdmap);
+
+  auto check = [&]() {
+    EXPECT_EQ(osdmap.get_epoch(), mapping.get_epoch());
+    for (auto& p : osdmap.get_pools()) {
+      for (unsigned ps = 0; ps < p.second.get_pg_num(); ++ps) {
+	pg_t pgid(ps, p.first);
+	vector<int> up, acting, mup, macting;
+	int up_primary, acting_primary, mup_primary, macting_primary;
+	osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+				    &acting, &acting_primary);
+	mapping.get(pgid, &mup, &mup_primary, &macting, &macting_primary);
+	EXPECT_EQ(up, mup) << pgid;
+	EXPECT_EQ(up_primary, mup_primary) << pgid;
+	EXPECT_EQ(acting, macting) << pgid;
+	EXPECT_EQ(acting_primary, macting_primary) << pgid;
+      }
+    }
+  };
+  auto apply = [&](OSDMap::Incremental& inc) {
+    osdmap.apply_incremental(inc);
+    mapping.update(osdmap, inc);
+    check();
+  };
+
+  {
+    // nothing that affects placement
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_up_thru[0] = osdmap.get_epoch();
+    apply(inc);
+    EXPECT_EQ("", mapping.get_full_reason());
+    EXPECT_EQ(0u, mapping.get_last_update_pgs());
+  }
+  pg_t pgid(0, my_rep_pool);
+  {
+    vector<int> up, acting;
+    osdmap.pg_to_up_acting_osds(pgid, &up, nullptr, &acting, nullptr);
+    std::reverse(acting.begin(), acting.end());
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[pgid] =
+      mempool::osdmap::vector<int>(acting.begin(), acting.end());
+    apply(inc);
+    EXPECT_EQ("", mapping.get_full_reason());
+    EXPECT_EQ(1u, mapping.get_last_update_pgs());
+  }
+  {
+    // only the pgs mapped to a down osd move
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[1] = CEPH_OSD_UP;
+    apply(inc);
+    EXPECT_EQ("", mapping.get_full_reason());
+    EXPECT_LT(0u, mapping.get_last_update_pgs());
+    EXPECT_EQ(mapping.get_osd_acting_pgs(1).size(), 0u);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[1] = CEPH_OSD_OUT;
+    apply(inc);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    entity_addrvec_t addrs;
+    addrs.v.push_back(entity_addr_t());
+    inc.new_up_client[1] = addrs;
+    inc.new_up_cluster[1] = addrs;
+    inc.new_hb_back_up[1] = addrs;
+    inc.new_hb_front_up[1] = addrs;
+    inc.new_weight[1] = CEPH_OSD_IN;
+    apply(inc);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_primary_affinity[2] = 0;
+    apply(inc);
+    EXPECT_EQ("", mapping.get_full_reason());
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[pgid] = mempool::osdmap::vector<int>();
+    inc.new_primary_temp[pg_t(1, my_ec_pool)] = 3;
+    apply(inc);
+    EXPECT_EQ("", mapping.get_full_reason());
+    EXPECT_EQ(2u, mapping.get_last_update_pgs());
+  }
+  {
+    // a skipped epoch can't be a delta
+    OSDMap::Incremental skipped(osdmap.get_epoch() + 1);
+    skipped.new_weight[4] = CEPH_OSD_OUT;
+    osdmap.apply_incremental(skipped);
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    apply(inc);
+    EXPECT_NE("", mapping.get_full_reason());
+  }
+}
+
 /** This test must be removed or modified appropriately when we allow
  * other ways to specify a primary. */
 TEST_F(OSDMapTest, PrimaryIsFirst) {
@@ -3243,6 +3243,54 @@ TEST_F(PGLogTrimTest, TestCopyAfter2) {
   EXPECT_EQ(7u, copy.dups.size()) << copy;
 }
 
+TEST(PGLogDupIndex, InsertEraseFind) {
+  entity_name_t client = entity_name_t::CLIENT(777);
+  std::list<pg_log_dup_t> dups;
+  PGLogDupIndex index;
+  const unsigned n = 1000;
+  for (unsigned i = 1; i <= n; ++i) {
+    dups.push_back(pg_log_dup_t(eversion_t(1, i), i,
+				osd_reqid_t(client, 8, i), 0));
+    index.insert(&dups.back());
+  }
+  EXPECT_EQ(n, index.size());
+  for (auto& d : dups) {
+    EXPECT_EQ(&d, index.find(d.reqid));
+  }
+  EXPECT_EQ(nullptr, index.find(osd_reqid_t(client, 8, n + 1)));
+  EXPECT_EQ(nullptr, index.find(osd_reqid_t(client, 9, 1)));
+
+  // trim from the tail while appending at the head, like the log does
+  for (unsigned i = n + 1; i <= 3 * n; ++i) {
+    index.erase(dups.front());
+    dups.pop_front();
+    dups.push_back(pg_log_dup_t(eversion_t(1, i), i,
+				osd_reqid_t(client, 8, i), 0));
+    index.insert(&dups.back());
+  }
+  EXPECT_EQ(n, index.size());
+  EXPECT_EQ(0u, index.count(osd_reqid_t(client, 8, 2 * n)));
+  for (auto& d : dups) {
+    EXPECT_EQ(&d, index.find(d.reqid));
+  }
+
+  // a resent reqid resolves to the newest dup
+  dups.push_back(pg_log_dup_t(eversion_t(2, 1), 1,
+			      osd_reqid_t(client, 8, 3 * n), 0));
+  index.insert(&dups.back());
+  EXPECT_EQ(&dups.back(), index.find(osd_reqid_t(client, 8, 3 * n)));
+  index.erase(dups.back());
+  EXPECT_EQ(eversion_t(1, 3 * n),
+	    index.find(osd_reqid_t(client, 8, 3 * n))->version);
+
+  PGLogDupIndex rebuilt;
+  rebuilt.build(dups);
+  EXPECT_EQ(n + 1, rebuilt.size());
+  rebuilt.clear();
+  EXPECT_TRUE(rebuilt.empty());
+  EXPECT_EQ(0u, rebuilt.count(dups.front().reqid));
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_pglog ; ./unittest_pglog --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
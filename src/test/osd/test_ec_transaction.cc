@@ -13,6 +13,7 @@
  */
 
 #include <gtest/gtest.h>
+#include "erasure-code/ErasureCode.h"
 #include "osd/PGTransaction.h"
 #include "osd/ECTransaction.h"
 
@@ -122,3 +123,167 @@ TEST(ectransaction, many_writes)
   ASSERT_EQ(0u, plan.to_read.size());
   ASSERT_EQ(1u, plan.will_write.size());
 }
+
+// k data chunks and one xor parity chunk: the simplest linear code,
+// enough to check delta writes against a full re-encode
+class XorParityCode final : public ceph::ErasureCode {
+  const unsigned k;
+public:
+  explicit XorParityCode(unsigned k) : k(k) {}
+  unsigned int get_chunk_count() const override {
+    return k + 1;
+  }
+  unsigned int get_data_chunk_count() const override {
+    return k;
+  }
+  unsigned int get_chunk_size(unsigned int object_size) const override {
+    return (object_size + k - 1) / k;
+  }
+  int encode_chunks(const set<int> &want_to_encode,
+		    map<int, bufferlist> *encoded) override {
+    char *p = (*encoded)[k].c_str();
+    unsigned len = (*encoded)[k].length();
+    memset(p, 0, len);
+    for (unsigned i = 0; i < k; ++i) {
+      const char *d = (*encoded)[i].c_str();
+      for (unsigned j = 0; j < len; ++j)
+	p[j] ^= d[j];
+    }
+    return 0;
+  }
+  int decode_chunks(const set<int> &want_to_read,
+		    const map<int, bufferlist> &chunks,
+		    map<int, bufferlist> *decoded) override {
+    ceph_abort();
+    return 0;
+  }
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  void apply_delta(const map<int, bufferptr> &in,
+		   map<int, bufferptr> &out) override {
+    for (auto &&i : in) {
+      for (auto &&o : out) {
+	for (unsigned j = 0; j < o.second.length(); ++j)
+	  o.second.c_str()[j] ^= i.second.c_str()[j];
+      }
+    }
+  }
+};
+
+TEST(ectransaction, delta_overwrite)
+{
+  const unsigned k = 3;
+  ceph::ErasureCodeInterfaceRef ec(new XorParityCode(k));
+  ECUtil::stripe_info_t sinfo(k, k * 256);
+  set<int> all;
+  for (unsigned i = 0; i <= k; ++i)
+    all.insert(i);
+
+  // two stripes of existing data
+  bufferlist old_bl;
+  for (unsigned i = 0; i < 2 * sinfo.get_stripe_width(); ++i)
+    old_bl.append((char)(i * 7));
+  map<int, bufferlist> shards;
+  ASSERT_EQ(0, ECUtil::encode(sinfo, ec, old_bl, all, &shards));
+
+  // overwrite part of the second data chunk of the first stripe
+  const uint64_t off = 300, len = 100;
+  bufferlist data;
+  data.append(string(len, 'Z'));
+  hobject_t h = hobject_t(object_t("delta"), "", CEPH_NOSNAP, 0, 1, "")
+    .make_temp_hobject("delta");
+  PGTransactionUPtr t(new PGTransaction);
+  t->write(h, off, len, data, 0);
+
+  auto plan = ECTransaction::get_write_plan(
+    sinfo,
+    std::move(t),
+    [&](const hobject_t &i) {
+      ECUtil::HashInfoRef ref(new ECUtil::HashInfo(k + 1));
+      ref->append(0, shards);
+      ref->set_projected_total_logical_size(sinfo, old_bl.length());
+      return ref;
+    },
+    &dpp);
+
+  // what ECBackend reads for a delta write: the touched data chunks and
+  // the parity over the same range
+  auto extent = ECTransaction::get_delta_extent(off, len);
+  plan.delta = true;
+  plan.delta_extent[h] = extent;
+  set<int> want;
+  sinfo.offset_len_to_data_chunks(extent, &want);
+  ASSERT_EQ(set<int>{1}, want);
+  for (auto i : want) {
+    auto range = sinfo.offset_len_to_chunk_range(extent, i);
+    plan.delta_read[h][i].substr_of(shards[i], range.first, range.second);
+  }
+  auto parity = sinfo.offset_len_to_parity_range(extent);
+  plan.delta_read[h][k].substr_of(shards[k], parity.first, parity.second);
+
+  map<shard_id_t, ObjectStore::Transaction> trans;
+  for (unsigned i = 0; i <= k; ++i)
+    trans[shard_id_t(i)];
+  vector<pg_log_entry_t> entries;
+  map<hobject_t, extent_map> written;
+  set<hobject_t> temp_added, temp_removed;
+  ECTransaction::generate_transactions(
+    plan, ec, pg_t(), sinfo, map<hobject_t, extent_map>(), entries,
+    &written, &trans, &temp_added, &temp_removed, &dpp,
+    ceph_release_t::octopus);
+
+  // apply the writes to the shards
+  map<int, unsigned> writes;
+  for (auto &&st : trans) {
+    int shard = st.first;
+    auto i = st.second.begin();
+    while (i.have_op()) {
+      auto op = i.decode_op();
+      switch (op->op) {
+      case ObjectStore::Transaction::OP_WRITE: {
+	bufferlist bl;
+	i.decode_bl(bl);
+	ASSERT_LE(op->off + op->len, shards[shard].length());
+	bufferlist head, tail;
+	head.substr_of(shards[shard], 0, op->off);
+	tail.substr_of(shards[shard], op->off + op->len,
+		       shards[shard].length() - op->off - op->len);
+	head.claim_append(bl);
+	head.claim_append(tail);
+	shards[shard].swap(head);
+	++writes[shard];
+	break;
+      }
+      case ObjectStore::Transaction::OP_SETATTR: {
+	i.decode_string();
+	bufferlist bl;
+	i.decode_bl(bl);
+	break;
+      }
+      case ObjectStore::Transaction::OP_SETATTRS: {
+	map<string, bufferlist> aset;
+	i.decode_attrset(aset);
+	break;
+      }
+      default:
+	break;
+      }
+    }
+  }
+  // only the touched data chunk and the parity were written
+  ASSERT_EQ((map<int, unsigned>{{1, 1}, {(int)k, 1}}), writes);
+
+  // and they match a full re-encode of the new content
+  bufferlist new_bl;
+  new_bl.substr_of(old_bl, 0, off);
+  new_bl.append(data);
+  bufferlist rest;
+  rest.substr_of(old_bl, off + len, old_bl.length() - off - len);
+  new_bl.append(rest);
+  map<int, bufferlist> expected;
+  ASSERT_EQ(0, ECUtil::encode(sinfo, ec, new_bl, all, &expected));
+  for (unsigned i = 0; i <= k; ++i) {
+    ASSERT_TRUE(expected[i].contents_equal(shards[i])) << "shard " << i;
+  }
+}
@@ -0,0 +1,65 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "osdc/Objecter.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr double factor = 2.0;
+constexpr ceph::timespan half_life = 30s;
+
+uint64_t calc(const std::vector<std::pair<uint64_t, ceph::timespan>> &samples,
+	      std::vector<uint64_t> *latencies)
+{
+  return Objecter::calc_read_latencies(samples, factor, half_life, latencies);
+}
+
+}
+
+TEST(Objecter, ReadLatencyUnknown)
+{
+  std::vector<uint64_t> latencies;
+  uint64_t slow = calc({{0, 0s}, {0, 0s}, {0, 0s}}, &latencies);
+  ASSERT_EQ(3u, latencies.size());
+  for (auto l : latencies) {
+    ASSERT_LE(l, slow);
+  }
+}
+
+TEST(Objecter, ReadLatencyExcludesSlow)
+{
+  std::vector<uint64_t> latencies;
+  // osd 1 has been 10x slower than osd 0 just now, osd 2 is unknown
+  uint64_t slow = calc({{1000000, 0s}, {10000000, 0s}, {0, 0s}},
+		       &latencies);
+  ASSERT_EQ(2000000u, slow);
+  ASSERT_LE(latencies[0], slow);
+  ASSERT_GT(latencies[1], slow);
+  ASSERT_LE(latencies[2], slow);
+
+  // still excluded a little later
+  latencies.clear();
+  slow = calc({{1000000, 0s}, {10000000, 10s}, {0, 0s}}, &latencies);
+  ASSERT_GT(latencies[1], slow);
+  ASSERT_LT(latencies[1], 10000000u);
+}
+
+TEST(Objecter, ReadLatencyRecovers)
+{
+  std::vector<uint64_t> latencies;
+  // a skipped osd gets no new samples; after enough half lives its
+  // estimate comes within the factor of the fastest one again
+  uint64_t slow = calc({{1000000, 0s}, {10000000, 120s}}, &latencies);
+  ASSERT_LE(latencies[1], slow);
+  ASSERT_GT(latencies[1], latencies[0]);
+
+  // no decay when disabled
+  latencies.clear();
+  slow = Objecter::calc_read_latencies(
+    {{1000000, 0s}, {10000000, 3600s}}, factor, 0s, &latencies);
+  ASSERT_EQ(10000000u, latencies[1]);
+  ASSERT_GT(latencies[1], slow);
+}